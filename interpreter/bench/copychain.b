@@ -0,0 +1,95 @@
+Carries a value along a row of two hundred cells and back again as
+many times as the input says
+
+,[->>[-]-[->+<]>[->+<]>[->+<]>[->+<]>[->+<]>[->+<]>[->+<]>[->+<]>[->+<]>
+[->+<]>[->+<]>[->+<]>[->+<]>[->+<]>[->+<]>[->+<]>[->+<]>[->+<]>[->+<]>[-
+>+<]>[->+<]>[->+<]>[->+<]>[->+<]>[->+<]>[->+<]>[->+<]>[->+<]>[->+<]>[->+
+<]>[->+<]>[->+<]>[->+<]>[->+<]>[->+<]>[->+<]>[->+<]>[->+<]>[->+<]>[->+<]
+>[->+<]>[->+<]>[->+<]>[->+<]>[->+<]>[->+<]>[->+<]>[->+<]>[->+<]>[->+<]>[
+->+<]>[->+<]>[->+<]>[->+<]>[->+<]>[->+<]>[->+<]>[->+<]>[->+<]>[->+<]>[->
++<]>[->+<]>[->+<]>[->+<]>[->+<]>[->+<]>[->+<]>[->+<]>[->+<]>[->+<]>[->+<
+]>[->+<]>[->+<]>[->+<]>[->+<]>[->+<]>[->+<]>[->+<]>[->+<]>[->+<]>[->+<]>
+[->+<]>[->+<]>[->+<]>[->+<]>[->+<]>[->+<]>[->+<]>[->+<]>[->+<]>[->+<]>[-
+>+<]>[->+<]>[->+<]>[->+<]>[->+<]>[->+<]>[->+<]>[->+<]>[->+<]>[->+<]>[->+
+<]>[->+<]>[->+<]>[->+<]>[->+<]>[->+<]>[->+<]>[->+<]>[->+<]>[->+<]>[->+<]
+>[->+<]>[->+<]>[->+<]>[->+<]>[->+<]>[->+<]>[->+<]>[->+<]>[->+<]>[->+<]>[
+->+<]>[->+<]>[->+<]>[->+<]>[->+<]>[->+<]>[->+<]>[->+<]>[->+<]>[->+<]>[->
++<]>[->+<]>[->+<]>[->+<]>[->+<]>[->+<]>[->+<]>[->+<]>[->+<]>[->+<]>[->+<
+]>[->+<]>[->+<]>[->+<]>[->+<]>[->+<]>[->+<]>[->+<]>[->+<]>[->+<]>[->+<]>
+[->+<]>[->+<]>[->+<]>[->+<]>[->+<]>[->+<]>[->+<]>[->+<]>[->+<]>[->+<]>[-
+>+<]>[->+<]>[->+<]>[->+<]>[->+<]>[->+<]>[->+<]>[->+<]>[->+<]>[->+<]>[->+
+<]>[->+<]>[->+<]>[->+<]>[->+<]>[->+<]>[->+<]>[->+<]>[->+<]>[->+<]>[->+<]
+>[->+<]>[->+<]>[->+<]>[->+<]>[->+<]>[->+<]>[->+<]>[->+<]>[->+<]>[->+<]>[
+->+<]>[->+<]>[->+<]>[->+<]>[->+<][-]>[-<+>>+<]>[-<+>]<[-]<<[-]>[-<+>>+<]
+>[-<+>]<[-]<<[-]>[-<+>>+<]>[-<+>]<[-]<<[-]>[-<+>>+<]>[-<+>]<[-]<<[-]>[-<
++>>+<]>[-<+>]<[-]<<[-]>[-<+>>+<]>[-<+>]<[-]<<[-]>[-<+>>+<]>[-<+>]<[-]<<[
+-]>[-<+>>+<]>[-<+>]<[-]<<[-]>[-<+>>+<]>[-<+>]<[-]<<[-]>[-<+>>+<]>[-<+>]<
+[-]<<[-]>[-<+>>+<]>[-<+>]<[-]<<[-]>[-<+>>+<]>[-<+>]<[-]<<[-]>[-<+>>+<]>[
+-<+>]<[-]<<[-]>[-<+>>+<]>[-<+>]<[-]<<[-]>[-<+>>+<]>[-<+>]<[-]<<[-]>[-<+>
+>+<]>[-<+>]<[-]<<[-]>[-<+>>+<]>[-<+>]<[-]<<[-]>[-<+>>+<]>[-<+>]<[-]<<[-]
+>[-<+>>+<]>[-<+>]<[-]<<[-]>[-<+>>+<]>[-<+>]<[-]<<[-]>[-<+>>+<]>[-<+>]<[-
+]<<[-]>[-<+>>+<]>[-<+>]<[-]<<[-]>[-<+>>+<]>[-<+>]<[-]<<[-]>[-<+>>+<]>[-<
++>]<[-]<<[-]>[-<+>>+<]>[-<+>]<[-]<<[-]>[-<+>>+<]>[-<+>]<[-]<<[-]>[-<+>>+
+<]>[-<+>]<[-]<<[-]>[-<+>>+<]>[-<+>]<[-]<<[-]>[-<+>>+<]>[-<+>]<[-]<<[-]>[
+-<+>>+<]>[-<+>]<[-]<<[-]>[-<+>>+<]>[-<+>]<[-]<<[-]>[-<+>>+<]>[-<+>]<[-]<
+<[-]>[-<+>>+<]>[-<+>]<[-]<<[-]>[-<+>>+<]>[-<+>]<[-]<<[-]>[-<+>>+<]>[-<+>
+]<[-]<<[-]>[-<+>>+<]>[-<+>]<[-]<<[-]>[-<+>>+<]>[-<+>]<[-]<<[-]>[-<+>>+<]
+>[-<+>]<[-]<<[-]>[-<+>>+<]>[-<+>]<[-]<<[-]>[-<+>>+<]>[-<+>]<[-]<<[-]>[-<
++>>+<]>[-<+>]<[-]<<[-]>[-<+>>+<]>[-<+>]<[-]<<[-]>[-<+>>+<]>[-<+>]<[-]<<[
+-]>[-<+>>+<]>[-<+>]<[-]<<[-]>[-<+>>+<]>[-<+>]<[-]<<[-]>[-<+>>+<]>[-<+>]<
+[-]<<[-]>[-<+>>+<]>[-<+>]<[-]<<[-]>[-<+>>+<]>[-<+>]<[-]<<[-]>[-<+>>+<]>[
+-<+>]<[-]<<[-]>[-<+>>+<]>[-<+>]<[-]<<[-]>[-<+>>+<]>[-<+>]<[-]<<[-]>[-<+>
+>+<]>[-<+>]<[-]<<[-]>[-<+>>+<]>[-<+>]<[-]<<[-]>[-<+>>+<]>[-<+>]<[-]<<[-]
+>[-<+>>+<]>[-<+>]<[-]<<[-]>[-<+>>+<]>[-<+>]<[-]<<[-]>[-<+>>+<]>[-<+>]<[-
+]<<[-]>[-<+>>+<]>[-<+>]<[-]<<[-]>[-<+>>+<]>[-<+>]<[-]<<[-]>[-<+>>+<]>[-<
++>]<[-]<<[-]>[-<+>>+<]>[-<+>]<[-]<<[-]>[-<+>>+<]>[-<+>]<[-]<<[-]>[-<+>>+
+<]>[-<+>]<[-]<<[-]>[-<+>>+<]>[-<+>]<[-]<<[-]>[-<+>>+<]>[-<+>]<[-]<<[-]>[
+-<+>>+<]>[-<+>]<[-]<<[-]>[-<+>>+<]>[-<+>]<[-]<<[-]>[-<+>>+<]>[-<+>]<[-]<
+<[-]>[-<+>>+<]>[-<+>]<[-]<<[-]>[-<+>>+<]>[-<+>]<[-]<<[-]>[-<+>>+<]>[-<+>
+]<[-]<<[-]>[-<+>>+<]>[-<+>]<[-]<<[-]>[-<+>>+<]>[-<+>]<[-]<<[-]>[-<+>>+<]
+>[-<+>]<[-]<<[-]>[-<+>>+<]>[-<+>]<[-]<<[-]>[-<+>>+<]>[-<+>]<[-]<<[-]>[-<
++>>+<]>[-<+>]<[-]<<[-]>[-<+>>+<]>[-<+>]<[-]<<[-]>[-<+>>+<]>[-<+>]<[-]<<[
+-]>[-<+>>+<]>[-<+>]<[-]<<[-]>[-<+>>+<]>[-<+>]<[-]<<[-]>[-<+>>+<]>[-<+>]<
+[-]<<[-]>[-<+>>+<]>[-<+>]<[-]<<[-]>[-<+>>+<]>[-<+>]<[-]<<[-]>[-<+>>+<]>[
+-<+>]<[-]<<[-]>[-<+>>+<]>[-<+>]<[-]<<[-]>[-<+>>+<]>[-<+>]<[-]<<[-]>[-<+>
+>+<]>[-<+>]<[-]<<[-]>[-<+>>+<]>[-<+>]<[-]<<[-]>[-<+>>+<]>[-<+>]<[-]<<[-]
+>[-<+>>+<]>[-<+>]<[-]<<[-]>[-<+>>+<]>[-<+>]<[-]<<[-]>[-<+>>+<]>[-<+>]<[-
+]<<[-]>[-<+>>+<]>[-<+>]<[-]<<[-]>[-<+>>+<]>[-<+>]<[-]<<[-]>[-<+>>+<]>[-<
++>]<[-]<<[-]>[-<+>>+<]>[-<+>]<[-]<<[-]>[-<+>>+<]>[-<+>]<[-]<<[-]>[-<+>>+
+<]>[-<+>]<[-]<<[-]>[-<+>>+<]>[-<+>]<[-]<<[-]>[-<+>>+<]>[-<+>]<[-]<<[-]>[
+-<+>>+<]>[-<+>]<[-]<<[-]>[-<+>>+<]>[-<+>]<[-]<<[-]>[-<+>>+<]>[-<+>]<[-]<
+<[-]>[-<+>>+<]>[-<+>]<[-]<<[-]>[-<+>>+<]>[-<+>]<[-]<<[-]>[-<+>>+<]>[-<+>
+]<[-]<<[-]>[-<+>>+<]>[-<+>]<[-]<<[-]>[-<+>>+<]>[-<+>]<[-]<<[-]>[-<+>>+<]
+>[-<+>]<[-]<<[-]>[-<+>>+<]>[-<+>]<[-]<<[-]>[-<+>>+<]>[-<+>]<[-]<<[-]>[-<
++>>+<]>[-<+>]<[-]<<[-]>[-<+>>+<]>[-<+>]<[-]<<[-]>[-<+>>+<]>[-<+>]<[-]<<[
+-]>[-<+>>+<]>[-<+>]<[-]<<[-]>[-<+>>+<]>[-<+>]<[-]<<[-]>[-<+>>+<]>[-<+>]<
+[-]<<[-]>[-<+>>+<]>[-<+>]<[-]<<[-]>[-<+>>+<]>[-<+>]<[-]<<[-]>[-<+>>+<]>[
+-<+>]<[-]<<[-]>[-<+>>+<]>[-<+>]<[-]<<[-]>[-<+>>+<]>[-<+>]<[-]<<[-]>[-<+>
+>+<]>[-<+>]<[-]<<[-]>[-<+>>+<]>[-<+>]<[-]<<[-]>[-<+>>+<]>[-<+>]<[-]<<[-]
+>[-<+>>+<]>[-<+>]<[-]<<[-]>[-<+>>+<]>[-<+>]<[-]<<[-]>[-<+>>+<]>[-<+>]<[-
+]<<[-]>[-<+>>+<]>[-<+>]<[-]<<[-]>[-<+>>+<]>[-<+>]<[-]<<[-]>[-<+>>+<]>[-<
++>]<[-]<<[-]>[-<+>>+<]>[-<+>]<[-]<<[-]>[-<+>>+<]>[-<+>]<[-]<<[-]>[-<+>>+
+<]>[-<+>]<[-]<<[-]>[-<+>>+<]>[-<+>]<[-]<<[-]>[-<+>>+<]>[-<+>]<[-]<<[-]>[
+-<+>>+<]>[-<+>]<[-]<<[-]>[-<+>>+<]>[-<+>]<[-]<<[-]>[-<+>>+<]>[-<+>]<[-]<
+<[-]>[-<+>>+<]>[-<+>]<[-]<<[-]>[-<+>>+<]>[-<+>]<[-]<<[-]>[-<+>>+<]>[-<+>
+]<[-]<<[-]>[-<+>>+<]>[-<+>]<[-]<<[-]>[-<+>>+<]>[-<+>]<[-]<<[-]>[-<+>>+<]
+>[-<+>]<[-]<<[-]>[-<+>>+<]>[-<+>]<[-]<<[-]>[-<+>>+<]>[-<+>]<[-]<<[-]>[-<
++>>+<]>[-<+>]<[-]<<[-]>[-<+>>+<]>[-<+>]<[-]<<[-]>[-<+>>+<]>[-<+>]<[-]<<[
+-]>[-<+>>+<]>[-<+>]<[-]<<[-]>[-<+>>+<]>[-<+>]<[-]<<[-]>[-<+>>+<]>[-<+>]<
+[-]<<[-]>[-<+>>+<]>[-<+>]<[-]<<[-]>[-<+>>+<]>[-<+>]<[-]<<[-]>[-<+>>+<]>[
+-<+>]<[-]<<[-]>[-<+>>+<]>[-<+>]<[-]<<[-]>[-<+>>+<]>[-<+>]<[-]<<[-]>[-<+>
+>+<]>[-<+>]<[-]<<[-]>[-<+>>+<]>[-<+>]<[-]<<[-]>[-<+>>+<]>[-<+>]<[-]<<[-]
+>[-<+>>+<]>[-<+>]<[-]<<[-]>[-<+>>+<]>[-<+>]<[-]<<[-]>[-<+>>+<]>[-<+>]<[-
+]<<[-]>[-<+>>+<]>[-<+>]<[-]<<[-]>[-<+>>+<]>[-<+>]<[-]<<[-]>[-<+>>+<]>[-<
++>]<[-]<<[-]>[-<+>>+<]>[-<+>]<[-]<<[-]>[-<+>>+<]>[-<+>]<[-]<<[-]>[-<+>>+
+<]>[-<+>]<[-]<<[-]>[-<+>>+<]>[-<+>]<[-]<<[-]>[-<+>>+<]>[-<+>]<[-]<<[-]>[
+-<+>>+<]>[-<+>]<[-]<<[-]>[-<+>>+<]>[-<+>]<[-]<<[-]>[-<+>>+<]>[-<+>]<[-]<
+<[-]>[-<+>>+<]>[-<+>]<[-]<<[-]>[-<+>>+<]>[-<+>]<[-]<<[-]>[-<+>>+<]>[-<+>
+]<[-]<<[-]>[-<+>>+<]>[-<+>]<[-]<<[-]>[-<+>>+<]>[-<+>]<[-]<<[-]>[-<+>>+<]
+>[-<+>]<[-]<<[-]>[-<+>>+<]>[-<+>]<[-]<<[-]>[-<+>>+<]>[-<+>]<[-]<<[-]>[-<
++>>+<]>[-<+>]<[-]<<[-]>[-<+>>+<]>[-<+>]<[-]<<[-]>[-<+>>+<]>[-<+>]<[-]<<[
+-]>[-<+>>+<]>[-<+>]<[-]<<[-]>[-<+>>+<]>[-<+>]<[-]<<[-]>[-<+>>+<]>[-<+>]<
+[-]<<[-]>[-<+>>+<]>[-<+>]<[-]<<[-]>[-<+>>+<]>[-<+>]<[-]<<[-]>[-<+>>+<]>[
+-<+>]<[-]<<[-]>[-<+>>+<]>[-<+>]<[-]<<[-]>[-<+>>+<]>[-<+>]<[-]<<[-]>[-<+>
+>+<]>[-<+>]<[-]<<[-]>[-<+>>+<]>[-<+>]<[-]<<[-]>[-<+>>+<]>[-<+>]<[-]<<[-]
+>[-<+>>+<]>[-<+>]<[-]<.[-]<<]
@@ -0,0 +1,35 @@
+Divides every number from the input down to 1 by every number from
+the input down to 1 and prints a running sum of the quotients and
+remainders after each row
+
+The transpiled code for this program in the language of kcuf
+
+    var N D Q R S
+    read N
+    wneq N 0
+      read D
+      wneq D 0
+        divmod N D Q R
+        inc S Q
+        inc S R
+        dec D 1
+      end
+      msg S
+      dec N 1
+    end
+
+,>>>>>[-]>[-]<<<<<<[->>>>>+>>+<<<<<<<]>>>>>>>[-<<<<<<<+>>>>>>>]<<[[-]>+<
+]>[-<+>]<[<<<<,>>>>>>[-]>[-]<<<<<<<[->>>>>>+>>+<<<<<<<<]>>>>>>>>[-<<<<<<
+<<+>>>>>>>>]<<[[-]>+<]>[-<+>]<[>>[-]>[-]>[-]>[-]>[-]>[-]>[-]>[-]<<<<<<<<
+<<<<<<<<[->>>>>>>>>+>>>>>>>>+<<<<<<<<<<<<<<<<<]>>>>>>>>>>>>>>>>>[-<<<<<<
+<<<<<<<<<<<+>>>>>>>>>>>>>>>>>]<<<<<<<<<<<<<<<<[->>>>>>>>>+>>>>>>>+<<<<<<
+<<<<<<<<<<]>>>>>>>>>>>>>>>>[-<<<<<<<<<<<<<<<<+>>>>>>>>>>>>>>>>]<<<<<<<[-
+>>>+>>>+<<<<<<]>>>>>>[-<<<<<<+>>>>>>]<<<<<<<[->>>+>->+<[>-]>[-<<<+>[-]<<
+[->>>+>>>+<<<<<<]>>>>>>[-<<<<<<+>>>>>>]<<<>>]<<<<<<]>[-]>>>[-]<<<<<<<<<<
+<[-]>>>>>>>>>[-<<<<<<<<<+>>>>>>>>>]<<<<<<<<[-]>>>>>>>>>[-<<<<<<<<<+>>>>>
+>>>>]<<<[-]<<<<<<<[->>>>>>>+>+<<<<<<<<]>>>>>>>>[-<<<<<<<<+>>>>>>>>]<[-<<
+<<<+>>>>>][-]<<<<<<[->>>>>>+>+<<<<<<<]>>>>>>>[-<<<<<<<+>>>>>>>]<[-<<<<<+
+>>>>>][-]+[-<<<<<<<<->>>>>>>>]<<[-]>[-]<<<<<<<[->>>>>>+>>+<<<<<<<<]>>>>>
+>>>[-<<<<<<<<+>>>>>>>>]<<[[-]>+<]>[-<+>]<][-]<<<.>>>[-][-]+[-<<<<<<<->>>
+>>>>]<<[-]>[-]<<<<<<[->>>>>+>>+<<<<<<<]>>>>>>>[-<<<<<<<+>>>>>>>]<<[[-]>+
+<]>[-<+>]<]
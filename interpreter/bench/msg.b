@@ -0,0 +1,44 @@
+Prints a sentence and a counter over and over again
+
+The transpiled code for this program in the language of kcuf
+
+    var I J
+    read I
+    wneq I 0
+      set J 100
+      wneq J 0
+        msg "the quick brown fox jumps over the lazy dog" J
+        dec J 1
+      end
+      dec I 1
+    end
+
+,>>[-]>[-]<<<[->>+>>+<<<<]>>>>[-<<<<+>>>>]<<[[-]>+<]>[-<+>]<[>>[-]++++++
+++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+++++++++++++++++++++++<<<[-]>>>[-<<<+>>>][-]>[-]<<<<[->>>+>>+<<<<<]>>>>>
+[-<<<<<+>>>>>]<<[[-]>+<]>[-<+>]<[>>[-]++++++++++++++++++++++++++++++++++
+++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+++++++++++.------------.---.--------------------------------------------
+-------------------------.++++++++++++++++++++++++++++++++++++++++++++++
++++++++++++++++++++++++++++++++++++.++++.------------.------.++++++++.--
+------------------------------------------------------------------------
+-.++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++.+++
++++++++++++++.---.++++++++.---------.-----------------------------------
+-------------------------------------------.++++++++++++++++++++++++++++
+++++++++++++++++++++++++++++++++++++++++++.+++++++++.+++++++++.---------
+------------------------------------------------------------------------
+-------.++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+++++++++++.+++++++++++.--------.+++.+++.--------------------------------
+---------------------------------------------------.++++++++++++++++++++
++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++.+++++++.----
+-------------.+++++++++++++.--------------------------------------------
+--------------------------------------.+++++++++++++++++++++++++++++++++
++++++++++++++++++++++++++++++++++++++++++++++++++++.------------.---.---
+------------------------------------------------------------------.+++++
++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++.
+-----------.+++++++++++++++++++++++++.-.--------------------------------
+---------------------------------------------------------.++++++++++++++
+++++++++++++++++++++++++++++++++++++++++++++++++++++++.+++++++++++.-----
+---.<<<<<.>>>>>[-][-]+[-<<<<<->>>>>]<<[-]>[-]<<<<[->>>+>>+<<<<<]>>>>>[-<
+<<<<+>>>>>]<<[[-]>+<]>[-<+>]<][-]+[-<<<<->>>>]<<[-]>[-]<<<[->>+>>+<<<<]>
+>>>[-<<<<+>>>>]<<[[-]>+<]>[-<+>]<]
@@ -0,0 +1,29 @@
+Multiplies every pair of numbers from the input down to 1 and prints
+a running sum of the products after each row
+
+The transpiled code for this program in the language of kcuf
+
+    var A B C S
+    read A
+    wneq A 0
+      set B A
+      wneq B 0
+        mul A B C
+        inc S C
+        dec B 1
+      end
+      msg S
+      dec A 1
+    end
+
+,>>>>[-]>[-]<<<<<[->>>>+>>+<<<<<<]>>>>>>[-<<<<<<+>>>>>>]<<[[-]>+<]>[-<+>
+]<[>>[-]<<<<<<[->>>>>>+>+<<<<<<<]>>>>>>>[-<<<<<<<+>>>>>>>]<<<<<<[-]>>>>>
+[-<<<<<+>>>>>][-]>[-]<<<<<<[->>>>>+>>+<<<<<<<]>>>>>>>[-<<<<<<<+>>>>>>>]<
+<[[-]>+<]>[-<+>]<[>>[-]>[-]>[-]<<<<<<<<<<[->>>>>>>>+>>>>+<<<<<<<<<<<<]>>
+>>>>>>>>>>[-<<<<<<<<<<<<+>>>>>>>>>>>>]<<<<<<<<<<<[->>>>>>>>+>>>+<<<<<<<<
+<<<]>>>>>>>>>>>[-<<<<<<<<<<<+>>>>>>>>>>>]<<<[-<[->>+>+<<<]>>>[-<<<+>>>]<
+<]<[-]<<<<<<[-]>>>>>>>>[-<<<<<<<<+>>>>>>>>]<<[-]<<<<<<[->>>>>>+>+<<<<<<<
+]>>>>>>>[-<<<<<<<+>>>>>>>]<[-<<<<<+>>>>>][-]+[-<<<<<<<->>>>>>>]<<[-]>[-]
+<<<<<<[->>>>>+>>+<<<<<<<]>>>>>>>[-<<<<<<<+>>>>>>>]<<[[-]>+<]>[-<+>]<][-]
+<<<.>>>[-][-]+[-<<<<<<->>>>>>]<<[-]>[-]<<<<<[->>>>+>>+<<<<<<]>>>>>>[-<<<
+<<<+>>>>>>]<<[[-]>+<]>[-<+>]<]
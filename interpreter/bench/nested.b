@@ -0,0 +1,8 @@
+Counts down four nested loops the input times and prints what the
+innermost loop added up
+
+,[->[-]+++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
++++++++++++++++++++++++++++++++++++[->[-]+++++++++++++++++++++++++++++++
++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++[->
+[-]++++++++++++++++++++++++++++++++++++++++++++++++++[->+++>+>[-]+++++++
+<<<]<]<]<]>>>>.>.>.
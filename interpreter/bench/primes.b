@@ -0,0 +1,44 @@
+Prints every prime below the input by trial division
+
+The transpiled code for this program in the language of kcuf
+
+    var N D Q R F L
+    read L
+    set N 2
+    wneq N L
+      set F 1
+      set D 2
+      wneq D N
+        divmod N D Q R
+        ifeq R 0
+          set F 0
+        end
+        inc D 1
+      end
+      ifeq F 1
+        msg N
+      end
+      inc N 1
+    end
+
+>>>>>,>[-]++<<<<<<[-]>>>>>>[-<<<<<<+>>>>>>][-]>[-]<<<<<<<[->>>>>>+>>+<<<
+<<<<<]>>>>>>>>[-<<<<<<<<+>>>>>>>>]<<<[->>+>+<<<]>>>[-<<<+>>>]<[-<->]<[[-
+]>+<]>[-<+>]<[>>[-]+<<<<[-]>>>>[-<<<<+>>>>][-]++<<<<<<<[-]>>>>>>>[-<<<<<
+<<+>>>>>>>][-]>[-]<<<<<<<<[->>>>>>>+>>+<<<<<<<<<]>>>>>>>>>[-<<<<<<<<<+>>
+>>>>>>>]<<<<<<<<<<[->>>>>>>>>+>+<<<<<<<<<<]>>>>>>>>>>[-<<<<<<<<<<+>>>>>>
+>>>>]<[-<->]<[[-]>+<]>[-<+>]<[>>[-]>[-]>[-]>[-]>[-]>[-]>[-]>[-]<<<<<<<<<
+<<<<<<<<[->>>>>>>>>>+>>>>>>>>+<<<<<<<<<<<<<<<<<<]>>>>>>>>>>>>>>>>>>[-<<<
+<<<<<<<<<<<<<<<+>>>>>>>>>>>>>>>>>>]<<<<<<<<<<<<<<<<<[->>>>>>>>>>+>>>>>>>
++<<<<<<<<<<<<<<<<<]>>>>>>>>>>>>>>>>>[-<<<<<<<<<<<<<<<<<+>>>>>>>>>>>>>>>>
+>]<<<<<<<[->>>+>>>+<<<<<<]>>>>>>[-<<<<<<+>>>>>>]<<<<<<<[->>>+>->+<[>-]>[
+-<<<+>[-]<<[->>>+>>>+<<<<<<]>>>>>>[-<<<<<<+>>>>>>]<<<>>]<<<<<<]>[-]>>>[-
+]<<<<<<<<<<<<[-]>>>>>>>>>>[-<<<<<<<<<<+>>>>>>>>>>]<<<<<<<<<[-]>>>>>>>>>>
+[-<<<<<<<<<<+>>>>>>>>>>]<<<[-]>[-]<<<<<<<<[->>>>>>>+>>+<<<<<<<<<]>>>>>>>
+>>[-<<<<<<<<<+>>>>>>>>>]<<[->+<]+>[[-]<->]<[>>[-]<<<<<<<<[-]>>>>>>>>[-<<
+<<<<<<+>>>>>>>>]<<[-]][-]+[-<<<<<<<<<+>>>>>>>>>]<<[-]>[-]<<<<<<<<[->>>>>
+>>+>>+<<<<<<<<<]>>>>>>>>>[-<<<<<<<<<+>>>>>>>>>]<<<<<<<<<<[->>>>>>>>>+>+<
+<<<<<<<<<]>>>>>>>>>>[-<<<<<<<<<<+>>>>>>>>>>]<[-<->]<[[-]>+<]>[-<+>]<][-]
+>[-]<<<<<[->>>>+>>+<<<<<<]>>>>>>[-<<<<<<+>>>>>>]<<-[->+<]+>[[-]<->]<[>>[
+-]<<<<<<<<<<.>>>>>>>>>>[-]<<[-]][-]+[-<<<<<<<<+>>>>>>>>]<<[-]>[-]<<<<<<<
+[->>>>>>+>>+<<<<<<<<]>>>>>>>>[-<<<<<<<<+>>>>>>>>]<<<[->>+>+<<<]>>>[-<<<+
+>>>]<[-<->]<[[-]>+<]>[-<+>]<]
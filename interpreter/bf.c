@@ -0,0 +1,2771 @@
+#include <ctype.h>
+#include <limits.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "bf.h"
+
+#if HAS_SIMD_SCAN
+#include <immintrin.h>
+#endif
+
+#if HAS_MMAP
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#if HAS_VIRTUAL_TAPE
+#include <signal.h>
+#include <stdint.h>
+#endif
+
+#define PARENTHESES_STACK_SIZE 512 // Initial size, grown as needed
+#define BUFFER_SIZE 1024
+
+/// The number of cells a new tape starts out with.
+#define INITIAL_TAPE_SIZE 4096
+
+/// @brief Stops a run of the machine right away, from anywhere inside of it,
+///        when it can't go on because it ran out of tape or memory.
+/// @param machine the machine
+/// @param reason why it stopped
+__attribute__((noreturn))
+static void stopRun(BFMachine *machine, StopReason reason) {
+    machine->stopReason = reason;
+    longjmp(machine->escape, 1);
+}
+
+/// Runs the statement so that stopRun() can stop it early, going on after it
+/// either way. These can be nested, so that code that has to clean up after
+/// itself can catch the stop first.
+#define CATCH_STOP(machine, ...)                                              \
+    {                                                                         \
+        jmp_buf outerEscape;                                                  \
+        memcpy(outerEscape, (machine)->escape, sizeof(jmp_buf));              \
+        if (setjmp((machine)->escape) == 0) {                                 \
+            __VA_ARGS__;                                                      \
+        }                                                                     \
+        memcpy((machine)->escape, outerEscape, sizeof(jmp_buf));              \
+    }
+
+/// @brief Creates a new tape with every cell set to 0.
+/// @return the tape
+Tape bfNewTape(void) {
+    Tape result;
+    result.cells = calloc(INITIAL_TAPE_SIZE, sizeof(CellValue));
+    result.capacity = INITIAL_TAPE_SIZE;
+    result.origin = INITIAL_TAPE_SIZE / 4;
+    result.head = 0;
+    result.isVirtual = false;
+    result.firstCommitted = 0;
+    result.endCommitted = 0;
+    return result;
+}
+
+#if HAS_VIRTUAL_TAPE
+
+/// The number of cells reserved for a virtual tape, half of them on each
+/// side of the initial cell.
+#define VIRTUAL_TAPE_SIZE (1 << 30)
+
+/// The size of the regions on both sides of a virtual tape that are never
+/// committed, so that the tape head running off either end can be caught.
+#define VIRTUAL_TAPE_GUARD_SIZE (1 << 28)
+
+/// The number of cells committed at once when the tape head first reaches
+/// a part of a virtual tape.
+#define VIRTUAL_TAPE_COMMIT_SIZE (1 << 16)
+
+/// The machine whose program this thread is running, or NULL. This is the
+/// one piece of state outside of the machines, since the fault handler can
+/// only find the tape that faulted through the thread it faulted on.
+static __thread BFMachine *runningMachine;
+
+/// @brief Handles the faults caused by touching parts of a virtual tape
+///        that haven't been committed yet by committing them, so that the
+///        faulting instruction can run again. Running into a guard region
+///        stops the run instead.
+/// @param signal the signal number
+/// @param info where the fault happened
+/// @param context unused
+static void virtualTapeFault(int signal, siginfo_t *info, void *context) {
+    (void) context;
+    CellValue *address = info->si_addr;
+    BFMachine *machine = runningMachine;
+    Tape *tape = machine != NULL && machine->tape.isVirtual ? &machine->tape : NULL;
+    if (tape != NULL && address >= tape->cells && address < tape->cells + VIRTUAL_TAPE_SIZE) {
+        size_t start = (size_t) (address - tape->cells) & ~(size_t) (VIRTUAL_TAPE_COMMIT_SIZE - 1);
+        if (mprotect(tape->cells + start, VIRTUAL_TAPE_COMMIT_SIZE, PROT_READ | PROT_WRITE) == 0) {
+            if (start < tape->firstCommitted) {
+                tape->firstCommitted = start;
+            }
+            if (start + VIRTUAL_TAPE_COMMIT_SIZE > tape->endCommitted) {
+                tape->endCommitted = start + VIRTUAL_TAPE_COMMIT_SIZE;
+            }
+            return;
+        }
+    } else if (tape != NULL && address >= tape->cells - VIRTUAL_TAPE_GUARD_SIZE &&
+               address < tape->cells + VIRTUAL_TAPE_SIZE + VIRTUAL_TAPE_GUARD_SIZE) {
+        // The handler doesn't block the signal, so jumping out of it leaves
+        // the thread able to take the next fault.
+        stopRun(machine, STOP_TAPE);
+    }
+    // Not a fault on a tape, so let it crash the program like it normally would.
+    struct sigaction action;
+    memset(&action, 0, sizeof(action));
+    action.sa_handler = SIG_DFL;
+    sigaction(signal, &action, NULL);
+}
+
+#endif
+
+/// @brief Creates a new tape with every cell set to 0 that is reserved as
+///        one huge mapping up front, so the tape head never has to be
+///        checked against the ends of the tape. Pages are only committed
+///        once the tape head reaches them.
+/// @param tape the tape to create
+/// @return true if succesful, false if the mapping couldn't be reserved
+///         (or virtual tapes aren't supported on this platform)
+bool bfNewVirtualTape(Tape *tape) {
+#if HAS_VIRTUAL_TAPE
+    const size_t size = VIRTUAL_TAPE_SIZE + 2 * (size_t) VIRTUAL_TAPE_GUARD_SIZE;
+    CellValue *reservation = mmap(NULL, size, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (reservation == MAP_FAILED) {
+        return false;
+    }
+
+    struct sigaction action;
+    memset(&action, 0, sizeof(action));
+    action.sa_sigaction = virtualTapeFault;
+    action.sa_flags = SA_SIGINFO | SA_NODEFER;
+    sigemptyset(&action.sa_mask);
+    sigaction(SIGSEGV, &action, NULL);
+    sigaction(SIGBUS, &action, NULL);
+
+    tape->cells = reservation + VIRTUAL_TAPE_GUARD_SIZE;
+    tape->capacity = VIRTUAL_TAPE_SIZE;
+    tape->origin = VIRTUAL_TAPE_SIZE / 2;
+    tape->head = 0;
+    tape->isVirtual = true;
+    tape->firstCommitted = VIRTUAL_TAPE_SIZE;
+    tape->endCommitted = 0;
+    return true;
+#else
+    (void) tape;
+    return false;
+#endif
+}
+
+/// @brief Grows the tape until the given tape index is a part of it.
+/// @param tape the tape to grow
+/// @param tapeIndex the tape index that must be on the tape
+/// @return false if the tape can't grow that far, because it is a virtual
+///         tape or there isn't enough memory
+static bool growTape(Tape *tape, int tapeIndex) {
+    if (tape->isVirtual) {
+        return false;
+    }
+    while (tape->origin + tapeIndex >= tape->capacity) {
+        CellValue *cells = tape->capacity <= INT_MAX / 2 ? realloc(tape->cells, 2 * tape->capacity) : NULL;
+        if (cells == NULL) {
+            return false;
+        }
+        tape->cells = cells;
+        memset(&tape->cells[tape->capacity], 0, tape->capacity);
+        tape->capacity *= 2;
+    }
+    while (tape->origin + tapeIndex < 0) {
+        CellValue *cells = tape->capacity <= INT_MAX / 2 ? calloc(2 * tape->capacity, sizeof(CellValue)) : NULL;
+        if (cells == NULL) {
+            return false;
+        }
+        memcpy(&cells[tape->capacity], tape->cells, tape->capacity);
+        free(tape->cells);
+        tape->cells = cells;
+        tape->origin += tape->capacity;
+        tape->capacity *= 2;
+    }
+    return true;
+}
+
+/// @brief Destroys the tape.
+/// @param tape to be destroyed
+void bfFreeTape(Tape *tape) {
+#if HAS_VIRTUAL_TAPE
+    if (tape->isVirtual) {
+        munmap(tape->cells - VIRTUAL_TAPE_GUARD_SIZE, VIRTUAL_TAPE_SIZE + 2 * (size_t) VIRTUAL_TAPE_GUARD_SIZE);
+        return;
+    }
+#endif
+    free(tape->cells);
+}
+
+/// @brief Finds the range of tape indices that may hold cells that aren't 0.
+/// @param tape the tape
+/// @param first where to put the first tape index of the range
+/// @param end where to put the tape index just past the range
+void bfUsedTapeIndices(Tape *tape, int *first, int *end) {
+    *first = -tape->origin;
+    *end = tape->capacity - tape->origin;
+#if HAS_VIRTUAL_TAPE
+    if (tape->isVirtual) {
+        // Only the committed cells can have been changed.
+        *first = tape->endCommitted == 0 ? 0 : (int) tape->firstCommitted - tape->origin;
+        *end = tape->endCommitted == 0 ? 0 : (int) tape->endCommitted - tape->origin;
+    }
+#endif
+}
+
+/// @brief Gets the tape cell at an offset from the tape head, growing the tape if needed.
+/// @param tape the tape
+/// @param offset the offset from the tape head
+/// @return the address of the tape cell, or NULL if the tape can't grow that far
+CellValue *bfCellAt(Tape *tape, int offset) {
+    const int tapeIndex = tape->head + offset;
+    if (tape->origin + tapeIndex < 0 || tape->origin + tapeIndex >= tape->capacity) {
+        if (!growTape(tape, tapeIndex)) {
+            return NULL;
+        }
+    }
+    return &tape->cells[tape->origin + tapeIndex];
+}
+
+/// @brief Grows a running machine's tape until every cell within a distance
+///        of the tape head is on it, stopping the run if it can't.
+/// @param machine the machine
+/// @param reach the distance
+/// @return the address of the current cell
+static CellValue *reachCells(BFMachine *machine, int reach) {
+    Tape *tape = &machine->tape;
+    if (reach > 0 && (bfCellAt(tape, -reach) == NULL || bfCellAt(tape, reach) == NULL)) {
+        stopRun(machine, STOP_TAPE);
+    }
+    CellValue *cell = bfCellAt(tape, 0);
+    if (cell == NULL) {
+        stopRun(machine, STOP_TAPE);
+    }
+    return cell;
+}
+
+/// @brief Reads a cell by its logical tape index, treating cells that were never allocated as 0.
+/// @param tape the tape to read from
+/// @param tapeIndex the logical index of the cell
+/// @return the value of the cell
+CellValue bfPeekCell(Tape *tape, int tapeIndex) {
+    int first, end;
+    bfUsedTapeIndices(tape, &first, &end);
+    return tapeIndex >= first && tapeIndex < end ? tape->cells[tape->origin + tapeIndex] : 0;
+}
+
+/// The size of the output buffer when it streams out to a file.
+#define OUTPUT_BUFFER_SIZE (1 << 16)
+
+/// The most bytes a single output value can take up ("255 ").
+#define MAX_VALUE_LENGTH 4
+
+/// @brief Writes out a chunk of output to a file, for outputs that go to one.
+/// @param file the file
+/// @param data the bytes to write
+/// @param length the number of bytes
+void bfWriteToFile(void *file, const char *data, size_t length) {
+    fwrite(data, 1, length, file);
+}
+
+/// @brief Writes everything in the output buffer out, unless it is being kept.
+/// @param output the output stream
+void bfFlushOutput(Output *output) {
+    if (output->write != NULL && output->index > 0) {
+        output->write(output->context, output->buffer, output->index);
+        output->index = 0;
+    }
+}
+
+/// @brief Makes room in the output buffer for at least one more value by
+///        flushing it, or by growing it when there is nowhere to flush to.
+/// @param output the output stream
+/// @return false if there isn't enough memory to grow it
+static bool makeRoomForOutput(Output *output) {
+    bfFlushOutput(output);
+    if (output->index + MAX_VALUE_LENGTH > output->capacity) {
+        const size_t capacity = output->capacity == 0 ? OUTPUT_BUFFER_SIZE : output->capacity * 2;
+        char *buffer = realloc(output->buffer, capacity);
+        if (buffer == NULL) {
+            return false;
+        }
+        output->buffer = buffer;
+        output->capacity = capacity;
+    }
+    return true;
+}
+
+/// @brief Appends a cell value to the output buffer, either as a byte or as
+///        a decimal number followed by a space.
+/// @param output the output stream
+/// @param value the value to output
+/// @return false if there isn't enough memory for it
+static bool writeValue(Output *output, CellValue value) {
+    if (output->index + MAX_VALUE_LENGTH > output->capacity && !makeRoomForOutput(output)) {
+        return false;
+    }
+    char *out = &output->buffer[output->index];
+    if (output->raw) {
+        *out++ = value;
+    } else {
+        if (value >= 100) {
+            *out++ = '0' + value / 100;
+            *out++ = '0' + value / 10 % 10;
+        } else if (value >= 10) {
+            *out++ = '0' + value / 10;
+        }
+        *out++ = '0' + value % 10;
+        *out++ = ' ';
+    }
+    output->index = out - output->buffer;
+    return true;
+}
+
+/// @brief Appends a cell value to a running machine's output, stopping the
+///        run if there isn't enough memory for it.
+/// @param machine the machine
+/// @param value the value to output
+static inline void outputValue(BFMachine *machine, CellValue value) {
+    if (!writeValue(&machine->output, value)) {
+        stopRun(machine, STOP_MEMORY);
+    }
+}
+
+/// @brief Reads in a chunk of input from a file, for inputs that come from one.
+/// @param file the file
+/// @param buffer where to put the bytes
+/// @param size the most bytes to read
+/// @return the number of bytes read
+static size_t readFromFile(void *file, unsigned char *buffer, size_t size) {
+    return fread(buffer, 1, size, file);
+}
+
+/// @brief Creates an input stream that gets its bytes from a function.
+/// @param read the function that reads the next chunk of input
+/// @param context what to pass to read
+/// @param raw whether to read single bytes instead of decimal numbers
+/// @return the input stream, or NULL if there's no memory for it
+Input *bfNewInput(ReadFunction read, void *context, bool raw) {
+    Input *input = malloc(sizeof(Input));
+    if (input == NULL) {
+        return NULL;
+    }
+    input->read = read;
+    input->context = context;
+    input->index = 0;
+    input->count = 0;
+    input->raw = raw;
+    return input;
+}
+
+/// @brief Opens an input stream.
+/// @param fileName the name of the file to read, or "-" for stdin
+/// @param raw whether to read single bytes instead of decimal numbers
+/// @return the input stream, or NULL if the file couldn't be opened
+Input *bfOpenInput(const char *fileName, bool raw) {
+    FILE *file = strcmp(fileName, "-") == 0 ? stdin : fopen(fileName, "rb");
+    if (file == NULL) {
+        return NULL;
+    }
+    Input *input = bfNewInput(readFromFile, file, raw);
+    if (input == NULL && file != stdin) {
+        fclose(file);
+    }
+    return input;
+}
+
+/// @brief Finds where an input stream is in its file.
+/// @param input the input stream
+/// @return the offset in the file of the next unread byte, or -1 if it
+///         doesn't come from a file
+long bfInputPosition(Input *input) {
+    if (input->read != readFromFile) {
+        return -1;
+    }
+    return ftell(input->context) - (long) (input->count - input->index);
+}
+
+/// @brief Goes back (or forward) to a position in an input stream.
+/// @param input the input stream
+/// @param position the offset in the file of the next byte to read
+/// @return true if succesful, false if the stream can't be read again (like a pipe)
+bool bfSeekInput(Input *input, long position) {
+    if (input->read != readFromFile || fseek(input->context, position, SEEK_SET) != 0) {
+        return false;
+    }
+    input->index = 0;
+    input->count = 0;
+    return true;
+}
+
+/// @brief Goes back to the start of an input stream.
+/// @param input the input stream
+/// @return true if succesful, false if the stream can't be read again (like a pipe)
+bool bfRewindInput(Input *input) {
+    return bfSeekInput(input, 0);
+}
+
+/// @brief Closes an input stream, along with its file if it opened one.
+/// @param input the input stream
+void bfCloseInput(Input *input) {
+    if (input->read == readFromFile && input->context != stdin) {
+        fclose(input->context);
+    }
+    free(input);
+}
+
+/// The size of the chunks files that can't be mapped are read in.
+#define READ_CHUNK_SIZE 65536
+
+/// @brief Reads a file in chunks into an allocated buffer, for files that
+///        can't be mapped into memory like pipes.
+/// @param filePtr the file to read
+/// @param contents the contents to fill in
+/// @return true if succesful
+static bool readChunks(FILE *filePtr, FileContents *contents) {
+    size_t capacity = READ_CHUNK_SIZE;
+    contents->data = malloc(capacity + 1);
+    contents->size = 0;
+    contents->mappedSize = 0;
+    size_t count;
+    while (contents->data && (count = fread(contents->data + contents->size, 1, capacity - contents->size, filePtr)) > 0) {
+        contents->size += count;
+        if (contents->size == capacity) {
+            capacity *= 2;
+            char *data = realloc(contents->data, capacity + 1);
+            if (data == NULL) {
+                free(contents->data);
+            }
+            contents->data = data;
+        }
+    }
+    if (contents->data == NULL || ferror(filePtr)) {
+        free(contents->data);
+        contents->data = NULL;
+        return false;
+    }
+    contents->data[contents->size] = '\0';
+    return true;
+}
+
+/// @brief Loads the whole of a file without limiting its size. Regular files
+///        are mapped straight into memory instead of being copied, with the
+///        '\0' after them coming from the zero filled memory past the end.
+/// @param fileName the name of the file to load
+/// @param contents the contents to fill in
+/// @return true if succesful
+bool bfLoadFile(const char *fileName, FileContents *contents) {
+#if HAS_MMAP
+    int fd = open(fileName, O_RDONLY);
+    if (fd < 0) {
+        return false;
+    }
+    struct stat status;
+    if (fstat(fd, &status) == 0 && S_ISREG(status.st_mode) && status.st_size > 0) {
+        // Reserve room for the file and at least one more byte, then map the
+        // file over the start of it.
+        const size_t pageSize = sysconf(_SC_PAGESIZE);
+        contents->size = status.st_size;
+        contents->mappedSize = (contents->size + pageSize) / pageSize * pageSize;
+        void *reserved = mmap(NULL, contents->mappedSize, PROT_READ, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (reserved != MAP_FAILED) {
+            void *data = mmap(reserved, contents->size, PROT_READ, MAP_PRIVATE | MAP_FIXED, fd, 0);
+            if (data != MAP_FAILED) {
+                close(fd);
+                contents->data = data;
+                return true;
+            }
+            munmap(reserved, contents->mappedSize);
+        }
+    }
+    close(fd);
+#endif
+    FILE *filePtr = fopen(fileName, "rb");
+    if (filePtr == NULL) {
+        return false;
+    }
+    bool result = readChunks(filePtr, contents);
+    fclose(filePtr);
+    return result;
+}
+
+/// @brief Releases the contents of a file.
+/// @param contents the contents of the file
+void bfUnloadFile(FileContents *contents) {
+#if HAS_MMAP
+    if (contents->mappedSize > 0) {
+        munmap(contents->data, contents->mappedSize);
+        return;
+    }
+#endif
+    free(contents->data);
+}
+
+/// @brief Looks at the next byte of the input stream without reading it,
+///        refilling the buffer if it has all been read.
+/// @param input the input stream
+/// @return the next byte, or EOF once the input runs out
+static int peekInput(Input *input) {
+    if (input->index == input->count) {
+        input->index = 0;
+        input->count = input->read(input->context, input->buffer, INPUT_BUFFER_SIZE);
+        if (input->count == 0) {
+            return EOF;
+        }
+    }
+    return input->buffer[input->index];
+}
+
+/// @brief Reads the next value from the input stream. In decimal mode this
+///        skips to the next number (which may start with a '-') and reads
+///        all of it, wrapping it mod 256.
+/// @param input the input stream, or NULL for none
+/// @return the value read as a cell value, or 0 once the input runs out
+static CellValue readValue(Input *input) {
+    if (input == NULL) {
+        return 0;
+    }
+    int next = peekInput(input);
+    if (input->raw) {
+        if (next == EOF) {
+            return 0;
+        }
+        ++input->index;
+        return next;
+    }
+
+    while (next != EOF && !isdigit(next) && next != '-') {
+        ++input->index;
+        next = peekInput(input);
+    }
+    bool negative = next == '-';
+    if (negative) {
+        ++input->index;
+        next = peekInput(input);
+    }
+    unsigned int value = 0;
+    while (next != EOF && isdigit(next)) {
+        value = value * 10 + (next - '0');
+        ++input->index;
+        next = peekInput(input);
+    }
+    return negative ? -value : value;
+}
+
+/// @brief Pushes an index onto a stack that grows as needed.
+/// @param stack the address of the stack
+/// @param count the address of the number of indices on the stack
+/// @param capacity the address of the capacity of the stack
+/// @param index the index to push
+static void pushIndex(int **stack, int *count, int *capacity, int index) {
+    if (*count >= *capacity) {
+        *capacity = *capacity == 0 ? PARENTHESES_STACK_SIZE : *capacity * 2;
+        *stack = realloc(*stack, *capacity * sizeof(int));
+    }
+    (*stack)[(*count)++] = index;
+}
+
+/// @brief Matches every bracket in the BF code with its partner.
+/// @param code the BF code string
+/// @return a jump table where the entry for each bracket is the index of its
+///         partner, or NULL if the brackets are unbalanced
+int *bfMatchBrackets(const char *code) {
+    int *jumps = calloc(strlen(code) + 1, sizeof(int));
+    int *openBrackets = NULL;
+    int openCount = 0;
+    int openCapacity = 0;
+
+    for (int i = 0; code[i] && jumps != NULL; ++i) {
+        if (code[i] == '[') {
+            pushIndex(&openBrackets, &openCount, &openCapacity, i);
+        } else if (code[i] == ']') {
+            if (openCount == 0) {
+                free(jumps);
+                jumps = NULL;
+            } else {
+                int open = openBrackets[--openCount];
+                jumps[open] = i;
+                jumps[i] = open;
+            }
+        }
+    }
+    if (openCount != 0) {
+        free(jumps);
+        jumps = NULL;
+    }
+
+    free(openBrackets);
+    return jumps;
+}
+
+/// @brief Searches for the next 0 one cell at a time.
+static int scanScalar(const CellValue *cells, int length, int start, int stride) {
+    int position = start;
+    while (position >= 0 && position < length && cells[position] != 0) {
+        position += stride;
+    }
+    return position;
+}
+
+#if HAS_SIMD_SCAN
+
+/// The number of cells checked one at a time before a SIMD scan starts,
+/// since most scans in BF code end after a few cells.
+#define SCAN_SCALAR_PREFIX 8
+
+/// @brief Gets a bit mask with every bit set whose distance from the lowest
+///        (or highest) bit is a multiple of the stride.
+/// @param stride the stride, which must divide 32
+/// @param fromTop true to measure the distance from the highest bit
+/// @param width the number of bits in the mask
+static inline unsigned int strideMask(int stride, bool fromTop, int width) {
+    unsigned int mask = stride == 32 ? 1 : 0xFFFFFFFFu / ((1u << stride) - 1);
+    if (fromTop) {
+        mask <<= (width - 1) % stride;
+    }
+    return width == 32 ? mask : mask & ((1u << width) - 1);
+}
+
+/// @brief Checks the first few cells of a scan one at a time.
+/// @return the position of the first 0, or the position to continue from
+static inline int scanPrefix(const CellValue *cells, int length, int start, int stride) {
+    int position = start;
+    for (int i = 0; i < SCAN_SCALAR_PREFIX && position >= 0 && position < length; ++i) {
+        if (cells[position] == 0) {
+            break;
+        }
+        position += stride;
+    }
+    return position;
+}
+
+/// @brief Searches for the next 0 sixteen cells at a time using SSE2 for
+///        strides that divide 16, and one cell at a time for all others.
+__attribute__((target("sse2")))
+static int scanSSE2(const CellValue *cells, int length, int start, int stride) {
+    const int distance = stride < 0 ? -stride : stride;
+    if (16 % distance != 0) {
+        return scanScalar(cells, length, start, stride);
+    }
+    int position = scanPrefix(cells, length, start, stride);
+    if (position < 0 || position >= length || cells[position] == 0) {
+        return position;
+    }
+    const __m128i zero = _mm_setzero_si128();
+    if (stride > 0) {
+        const unsigned int mask = strideMask(distance, false, 16);
+        for (; position + 16 <= length; position += 16) {
+            __m128i chunk = _mm_loadu_si128((const __m128i *) &cells[position]);
+            unsigned int zeros = _mm_movemask_epi8(_mm_cmpeq_epi8(chunk, zero)) & mask;
+            if (zeros != 0) {
+                return position + __builtin_ctz(zeros);
+            }
+        }
+    } else {
+        const unsigned int mask = strideMask(distance, true, 16);
+        for (; position - 15 >= 0; position -= 16) {
+            __m128i chunk = _mm_loadu_si128((const __m128i *) &cells[position - 15]);
+            unsigned int zeros = _mm_movemask_epi8(_mm_cmpeq_epi8(chunk, zero)) & mask;
+            if (zeros != 0) {
+                return position - 15 + 31 - __builtin_clz(zeros);
+            }
+        }
+    }
+    return scanScalar(cells, length, position, stride);
+}
+
+/// @brief Searches for the next 0 thirty-two cells at a time using AVX2 for
+///        strides that divide 32, and one cell at a time for all others.
+__attribute__((target("avx2")))
+static int scanAVX2(const CellValue *cells, int length, int start, int stride) {
+    const int distance = stride < 0 ? -stride : stride;
+    if (32 % distance != 0) {
+        return scanScalar(cells, length, start, stride);
+    }
+    int position = scanPrefix(cells, length, start, stride);
+    if (position < 0 || position >= length || cells[position] == 0) {
+        return position;
+    }
+    const __m256i zero = _mm256_setzero_si256();
+    if (stride > 0) {
+        const unsigned int mask = strideMask(distance, false, 32);
+        for (; position + 32 <= length; position += 32) {
+            __m256i chunk = _mm256_loadu_si256((const __m256i *) &cells[position]);
+            unsigned int zeros = (unsigned int) _mm256_movemask_epi8(_mm256_cmpeq_epi8(chunk, zero)) & mask;
+            if (zeros != 0) {
+                return position + __builtin_ctz(zeros);
+            }
+        }
+    } else {
+        const unsigned int mask = strideMask(distance, true, 32);
+        for (; position - 31 >= 0; position -= 32) {
+            __m256i chunk = _mm256_loadu_si256((const __m256i *) &cells[position - 31]);
+            unsigned int zeros = (unsigned int) _mm256_movemask_epi8(_mm256_cmpeq_epi8(chunk, zero)) & mask;
+            if (zeros != 0) {
+                return position - 31 + 31 - __builtin_clz(zeros);
+            }
+        }
+    }
+    return scanScalar(cells, length, position, stride);
+}
+
+#endif
+
+/// @brief Picks the fastest scan function the CPU supports.
+/// @param name where to put the name of the scan function, or NULL
+/// @return the scan function
+static ScanFunction fastestScan(const char **name) {
+    ScanFunction scan = scanScalar;
+    const char *scanName = "scalar";
+#if HAS_SIMD_SCAN
+    if (__builtin_cpu_supports("avx2")) {
+        scan = scanAVX2;
+        scanName = "avx2";
+    } else if (__builtin_cpu_supports("sse2")) {
+        scan = scanSSE2;
+        scanName = "sse2";
+    }
+#endif
+    if (name != NULL) {
+        *name = scanName;
+    }
+    return scan;
+}
+
+/// @brief Processes the command from the code at the given codeIndex on a machine.
+/// @param code the BF code string
+/// @param jumps the jump table of the BF code's brackets
+/// @param codeIndex the address of the index into the BF code string
+/// @param machine the machine to execute the code on, whose program isn't used
+/// @return false if the machine ran out of tape or memory, which sets its
+///         stop reason
+bool bfProcess(
+        const char *code,
+        int *jumps,
+        int *codeIndex,
+        BFMachine *machine) {
+    CellValue *cell = bfCellAt(&machine->tape, 0);
+    if (cell == NULL) {
+        machine->stopReason = STOP_TAPE;
+        return false;
+    }
+
+    // Main switch statement
+    switch (code[*codeIndex]) {
+        case '+':
+            (*cell)++;
+            break;
+        case '-':
+            (*cell)--;
+            break;
+        case '>':
+            ++machine->tape.head;
+            break;
+        case '<':
+            --machine->tape.head;
+            break;
+        case '.':
+            if (!writeValue(&machine->output, *cell)) {
+                machine->stopReason = STOP_MEMORY;
+                return false;
+            }
+            break;
+        case ',':
+            *cell = readValue(machine->input);
+            break;
+        case '[':
+            if (*cell == 0) {
+                *codeIndex = jumps[*codeIndex];
+            }
+            break;
+        case ']':
+            if (*cell != 0) {
+                *codeIndex = jumps[*codeIndex] - 1;
+            }
+            break;
+    }
+    return true;
+}
+
+/// The names of the operations, for printing.
+const char *const bfOpNames[] = {
+    [OP_ADD] = "ADD",
+    [OP_MOVE] = "MOVE",
+    [OP_OUT] = "OUT",
+    [OP_IN] = "IN",
+    [OP_JZ] = "JZ",
+    [OP_JNZ] = "JNZ",
+    [OP_SET] = "SET",
+    [OP_MUL] = "MUL",
+    [OP_PRODUCT] = "PRODUCT",
+    [OP_SCAN] = "SCAN",
+    [OP_TRAP] = "TRAP",
+    [OP_END] = "END",
+    [OP_ADD_ADD] = "ADD+ADD",
+    [OP_ADD_MOVE] = "ADD+MOVE",
+    [OP_ADD_OUT] = "ADD+OUT",
+    [OP_OUT_ADD] = "OUT+ADD",
+    [OP_SET_MOVE] = "SET+MOVE",
+    [OP_MUL_SET] = "MUL+SET",
+    [OP_MOVE_JZ] = "MOVE+JZ",
+    [OP_MOVE_JNZ] = "MOVE+JNZ",
+};
+
+// The most common pairs of operations in the benchmark corpus, in the order
+// of the OpCode enum.
+const Superinstruction bfSuperinstructions[] = {
+    {OP_ADD_ADD, OP_ADD, OP_ADD},
+    {OP_ADD_MOVE, OP_ADD, OP_MOVE},
+    {OP_ADD_OUT, OP_ADD, OP_OUT},
+    {OP_OUT_ADD, OP_OUT, OP_ADD},
+    {OP_SET_MOVE, OP_SET, OP_MOVE},
+    {OP_MUL_SET, OP_MUL, OP_SET},
+    {OP_MOVE_JZ, OP_MOVE, OP_JZ},
+    {OP_MOVE_JNZ, OP_MOVE, OP_JNZ},
+};
+
+const int bfSuperinstructionCount = sizeof(bfSuperinstructions) / sizeof(bfSuperinstructions[0]);
+
+/// @brief Gets the operation an instruction runs first, which is the first
+///        of the two for a superinstruction.
+/// @param op the operation of the instruction
+/// @return the operation it runs first
+OpCode bfBaseOp(OpCode op) {
+    return op > OP_END ? bfSuperinstructions[op - OP_END - 1].first : op;
+}
+
+/// @brief Puts superinstructions in place of the first of every two
+///        instructions in a row that one of them runs. The instructions
+///        themselves stay where they are, so nothing else has to change.
+/// @param program the optimized program
+static void fuseInstructions(Program *program) {
+    Instruction *instructions = program->instructions;
+    for (int i = 0; i + 1 < program->count; ++i) {
+        // The second instruction is never fused yet, since this goes forwards.
+        for (int j = 0; j < bfSuperinstructionCount; ++j) {
+            if (instructions[i].op == bfSuperinstructions[j].first &&
+                instructions[i + 1].op == bfSuperinstructions[j].second) {
+                instructions[i].op = bfSuperinstructions[j].op;
+                break;
+            }
+        }
+    }
+}
+
+/// @brief Appends an instruction to the program.
+/// @param program the program to append to
+/// @param op the operation
+/// @param arg the operand
+/// @param offset the tape offset the instruction works on
+/// @param pos the index into the BF code the instruction came from
+static void emit(Program *program, OpCode op, int arg, int offset, int pos) {
+    if (program->count >= program->capacity) {
+        program->capacity = program->capacity == 0 ? BUFFER_SIZE : program->capacity * 2;
+        program->instructions = realloc(program->instructions, program->capacity * sizeof(Instruction));
+    }
+    program->instructions[program->count++] = (Instruction) {op, arg, offset, pos, 0};
+}
+
+/// The most cells a loop can touch and still be run in closed form.
+#define MAX_LOOP_CELLS 64
+
+/// @brief The value of a cell after one iteration of a loop, as a constant
+///        plus the value each cell the loop touches had before it, times a
+///        factor, all mod 256.
+typedef struct {
+    CellValue factors[MAX_LOOP_CELLS];
+    CellValue constant;
+} AffineValue;
+
+/// @brief Finds a cell among the cells a loop touches, adding it if it is new
+///        with its value so far being just its value before the iteration.
+/// @param offsets the offsets of the cells from the loop's starting cell
+/// @param values the values of the cells so far in the iteration
+/// @param cellCount the address of the number of cells
+/// @param offset the offset of the cell to find
+/// @return the index of the cell, or -1 if the loop touches too many cells
+static int loopCell(int *offsets, AffineValue *values, int *cellCount, int offset) {
+    for (int j = 0; j < *cellCount; ++j) {
+        if (offsets[j] == offset) {
+            return j;
+        }
+    }
+    if (*cellCount == MAX_LOOP_CELLS) {
+        return -1;
+    }
+    int j = (*cellCount)++;
+    offsets[j] = offset;
+    values[j] = (AffineValue) {0};
+    values[j].factors[j] = 1;
+    return j;
+}
+
+/// @brief Replaces the loop at the end of the program with straight-line
+///        operations if it is a clear loop, a scan loop, or a balanced loop.
+///        A balanced loop only contains +-<> and loops already replaced
+///        with OP_MUL and OP_SET, returns to where it started, and increases
+///        or decreases the starting cell by exactly 1. Every other cell it
+///        changes has to either be set to a constant, or gain the same
+///        amount every iteration: a constant plus multiples of cells the
+///        loop leaves as they were. Then n iterations just add n times that
+///        amount, so a nested multiply loop like [->[->+>+<<]>>[-<<+>>]<<<]
+///        runs in the same few operations for any count.
+/// @param program the program whose last instructions are the body of the loop
+/// @param open the index of the loop's OP_JZ instruction
+/// @param close the index into the BF code of the loop's ']'
+/// @return true if the loop was replaced
+static bool optimizeLoop(Program *program, int open, int close) {
+    Instruction *body = &program->instructions[open + 1];
+    const int bodyCount = program->count - open - 1;
+    const int pos = program->instructions[open].pos;
+
+    // [-], [+] and any other single odd addition always ends with a 0.
+    if (bodyCount == 1 && body[0].op == OP_ADD && body[0].arg % 2 == 1) {
+        program->count = open;
+        emit(program, OP_SET, 0, 0, pos);
+        return true;
+    }
+
+    // [>], [<<<<] and so on.
+    if (bodyCount == 1 && body[0].op == OP_MOVE) {
+        int stride = body[0].arg;
+        program->count = open;
+        emit(program, OP_SCAN, stride, 0, pos);
+        return true;
+    }
+
+    // Work out the value of every cell after one iteration of the loop.
+    int offsets[MAX_LOOP_CELLS];
+    AffineValue values[MAX_LOOP_CELLS];
+    int cellCount = 0;
+    int offset = 0;
+    loopCell(offsets, values, &cellCount, 0);
+    for (int i = 0; i < bodyCount; ++i) {
+        if (body[i].op == OP_MOVE) {
+            offset += body[i].arg;
+            continue;
+        }
+        if (body[i].op != OP_ADD && body[i].op != OP_SET && body[i].op != OP_MUL) {
+            return false;
+        }
+        int source = loopCell(offsets, values, &cellCount, offset);
+        int target = loopCell(offsets, values, &cellCount, offset + body[i].offset);
+        if (source < 0 || target < 0) {
+            return false;
+        }
+        if (body[i].op == OP_ADD) {
+            values[target].constant += body[i].arg;
+        } else if (body[i].op == OP_SET) {
+            values[target] = (AffineValue) {.constant = body[i].arg};
+        } else {
+            AffineValue added = values[source];
+            for (int j = 0; j < cellCount; ++j) {
+                values[target].factors[j] += added.factors[j] * body[i].arg;
+            }
+            values[target].constant += added.constant * body[i].arg;
+        }
+    }
+
+    // The loop has to end where it started, and count the starting cell down
+    // (or up) to 0 by 1 each time.
+    const CellValue step = values[0].constant;
+    values[0].constant = 0;
+    bool unchanged[MAX_LOOP_CELLS];
+    for (int j = 0; j < cellCount; ++j) {
+        unchanged[j] = values[j].constant == 0;
+        for (int k = 0; k < cellCount; ++k) {
+            unchanged[j] = unchanged[j] && values[j].factors[k] == (j == k);
+        }
+    }
+    if (offset != 0 || (step != 1 && step != (CellValue) -1) || !unchanged[0]) {
+        return false;
+    }
+    unchanged[0] = false;
+
+    // A cell the loop sets to a constant has that value in every iteration
+    // after the first, like the temporary cell of a copy loop, which the
+    // loop then leaves as it was. Only the first iteration has to see what
+    // the cell was before the loop, and only if another cell depends on it.
+    bool setsCells = false;
+    bool readsSetCells = false;
+    bool set[MAX_LOOP_CELLS];
+    for (int j = 0; j < cellCount; ++j) {
+        set[j] = j != 0 && !unchanged[j];
+        for (int k = 0; k < cellCount; ++k) {
+            set[j] = set[j] && values[j].factors[k] == 0;
+        }
+        setsCells = setsCells || set[j];
+    }
+    for (int j = 0; setsCells && j < cellCount; ++j) {
+        if (set[j]) {
+            unchanged[j] = true;
+            continue;
+        }
+        for (int k = 0; k < cellCount; ++k) {
+            if (set[k]) {
+                readsSetCells = readsSetCells || values[j].factors[k] != 0;
+                values[j].constant += values[j].factors[k] * values[k].constant;
+                values[j].factors[k] = 0;
+            }
+        }
+        unchanged[j] = values[j].constant == 0;
+        for (int k = 0; k < cellCount; ++k) {
+            unchanged[j] = unchanged[j] && values[j].factors[k] == (j == k);
+        }
+    }
+
+    // Every other cell has to gain the same amount each iteration, which
+    // only depends on cells that stay the same.
+    for (int j = 1; j < cellCount; ++j) {
+        if (unchanged[j]) {
+            continue;
+        }
+        if (values[j].factors[j] != 1) {
+            return false;
+        }
+        for (int k = 0; k < cellCount; ++k) {
+            if (k != j && values[j].factors[k] != 0 && !unchanged[k]) {
+                return false;
+            }
+        }
+    }
+
+    // Cells only get set if the loop runs at all, so then the replacement
+    // stays inside the loop, which ends after one iteration. Reading them
+    // takes running the first iteration as it is, with the rest of the
+    // iterations added after it.
+    program->count = !setsCells ? open : readsSetCells ? program->count : open + 1;
+    for (int j = 1; j < cellCount; ++j) {
+        if (set[j] && !readsSetCells) {
+            emit(program, OP_SET, values[j].constant, offsets[j], pos);
+        }
+        if (unchanged[j]) {
+            continue;
+        }
+        // Counting up to 0 takes 256 - value iterations instead of value.
+        CellValue sign = step == 1 ? -1 : 1;
+        if (values[j].constant != 0) {
+            emit(program, OP_MUL, (CellValue) (values[j].constant * sign), offsets[j], pos);
+        }
+        for (int k = 0; k < cellCount; ++k) {
+            if (k != j && values[j].factors[k] != 0) {
+                CellValue factor = values[j].factors[k] * sign;
+                emit(program, OP_PRODUCT, PRODUCT_ARG(offsets[k], factor), offsets[j], pos);
+            }
+        }
+    }
+    emit(program, OP_SET, 0, 0, pos);
+    if (setsCells) {
+        emit(program, OP_JNZ, open + 1, 0, close);
+        program->instructions[open].arg = program->count;
+    }
+    return true;
+}
+
+/// @brief Folds the moves in each straight run of an optimized program into
+///        the offsets of the instructions after them, so that >>>+<<<- runs
+///        as ADD 1 at offset 3 and ADD 255 at offset 0 without moving the
+///        tape head at all. The tape head only moves (once, by however far
+///        the run moved it) before the instructions that need it to really
+///        be there: jumps, OP_MUL, OP_PRODUCT, OP_SCAN and OP_END. Adds and sets of the
+///        same cell right after each other are merged along the way, like
+///        [-]+++ into SET 3.
+/// @param program the program, which only gets shorter, and which is left
+///        with how far its instructions reach from the tape head
+static void foldMoves(Program *program) {
+    Instruction *instructions = program->instructions;
+    // Where each instruction ended up, for moving the jump targets. Since a
+    // run only ever starts right after a jump, with nothing left to move,
+    // an instruction folded away is replaced by whatever comes after it.
+    int *newIndices = malloc(program->count * sizeof(int));
+    int count = 0;
+    int pending = 0;
+    int movePos = 0;
+    for (int i = 0; i < program->count; ++i) {
+        Instruction instruction = instructions[i];
+        newIndices[i] = count;
+        switch (instruction.op) {
+            case OP_MOVE:
+                pending += instruction.arg;
+                movePos = instruction.pos;
+                continue;
+            case OP_ADD:
+            case OP_SET:
+            case OP_OUT:
+            case OP_IN:
+                instruction.offset += pending;
+                break;
+            default:
+                // The instruction needs the tape head where it really is. A
+                // move is only pending after at least one OP_MOVE was folded
+                // away, so it always has room.
+                if (pending != 0) {
+                    instructions[count++] = (Instruction) {OP_MOVE, pending, 0, movePos, 0};
+                    pending = 0;
+                }
+                break;
+        }
+
+        Instruction *previous = count > 0 ? &instructions[count - 1] : NULL;
+        bool sameCell = previous != NULL && (previous->op == OP_ADD || previous->op == OP_SET) &&
+                        previous->offset == instruction.offset;
+        if (sameCell && instruction.op == OP_SET) {
+            previous->op = OP_SET;
+            previous->arg = instruction.arg;
+        } else if (sameCell && instruction.op == OP_ADD) {
+            previous->arg = (CellValue) (previous->arg + instruction.arg);
+            if (previous->op == OP_ADD && previous->arg == 0) {
+                --count;
+            }
+        } else {
+            instructions[count++] = instruction;
+        }
+    }
+
+    for (int i = 0; i < count; ++i) {
+        if (instructions[i].op == OP_JZ || instructions[i].op == OP_JNZ) {
+            instructions[i].arg = newIndices[instructions[i].arg];
+            continue;
+        }
+        if (abs(instructions[i].offset) > program->reach) {
+            program->reach = abs(instructions[i].offset);
+        }
+        if (instructions[i].op == OP_PRODUCT && abs(PRODUCT_SOURCE(instructions[i].arg)) > program->reach) {
+            program->reach = abs(PRODUCT_SOURCE(instructions[i].arg));
+        }
+    }
+    program->count = count;
+    free(newIndices);
+}
+
+/// @brief Compiles BF code into bytecode, folding runs of +- and <> into
+///        single instructions, replacing common loops with single operations,
+///        and resolving the targets of all jumps.
+/// @param code the BF code string
+/// @param program the program to compile into
+/// @param optimize false to compile every BF character into an instruction
+///        of its own instead, so that execution can stop at any of them
+/// @return true if succesful, false if the brackets are unbalanced
+bool bfCompile(const char *code, Program *program, bool optimize) {
+    int *openBrackets = NULL;
+    int openCount = 0;
+    int openCapacity = 0;
+    bool result = true;
+
+    for (int i = 0; code[i] && result; ++i) {
+        int start = i;
+        int amount = 0;
+        switch (code[i]) {
+            case '+':
+            case '-':
+                for (; (code[i] == '+' || code[i] == '-') && (optimize || i == start); ++i) {
+                    amount += code[i] == '+' ? 1 : -1;
+                }
+                --i;
+                if ((CellValue) amount != 0) {
+                    emit(program, OP_ADD, (CellValue) amount, 0, start);
+                }
+                break;
+            case '>':
+            case '<':
+                for (; (code[i] == '>' || code[i] == '<') && (optimize || i == start); ++i) {
+                    amount += code[i] == '>' ? 1 : -1;
+                }
+                --i;
+                if (amount != 0) {
+                    emit(program, OP_MOVE, amount, 0, start);
+                }
+                break;
+            case '.':
+                emit(program, OP_OUT, 0, 0, i);
+                break;
+            case ',':
+                emit(program, OP_IN, 0, 0, i);
+                break;
+            case '[':
+                pushIndex(&openBrackets, &openCount, &openCapacity, program->count);
+                emit(program, OP_JZ, 0, 0, i);
+                break;
+            case ']':
+                if (openCount == 0) {
+                    result = false;
+                } else {
+                    int open = openBrackets[--openCount];
+                    if (!optimize || !optimizeLoop(program, open, i)) {
+                        // Unoptimized loops go back to their '[' like bfProcess() does,
+                        // so that stepping through them stops at the same places.
+                        emit(program, OP_JNZ, optimize ? open + 1 : open, 0, i);
+                        program->instructions[open].arg = program->count;
+                    }
+                }
+                break;
+        }
+    }
+    emit(program, OP_END, 0, 0, strlen(code));
+    if (optimize && result && openCount == 0) {
+        foldMoves(program);
+    }
+
+    // Execution only ever jumps to just after a jump, so the engines can
+    // count the steps of a whole straight run at once when they get to the
+    // jump (or the end) at the end of it. I/O checks the limits too, so it
+    // splits the run, and its own step is counted with the ones after it.
+    if (optimize) {
+        int run = 0;
+        for (int i = 0; i < program->count; ++i) {
+            Instruction *instruction = &program->instructions[i];
+            if (instruction->op == OP_END) {
+                instruction->steps = run;
+                break;
+            }
+            if (instruction->op == OP_OUT || instruction->op == OP_IN) {
+                instruction->steps = run;
+                run = 0;
+            }
+            ++run;
+            if (instruction->op == OP_JZ || instruction->op == OP_JNZ) {
+                instruction->steps = run;
+                run = 0;
+            }
+        }
+        if (result && openCount == 0) {
+            fuseInstructions(program);
+        }
+    }
+
+    free(openBrackets);
+    return result && openCount == 0;
+}
+
+/// @brief Replaces an instruction with a trap, so that the engine with traps
+///        stops before running it.
+/// @param program the program
+/// @param traps the traps patched into the program
+/// @param index the index of the instruction
+void bfSetTrap(Program *program, Traps *traps, int index) {
+    Instruction *instruction = &program->instructions[index];
+    if (instruction->op != OP_TRAP) {
+        traps->savedOps[index] = instruction->op;
+        instruction->op = OP_TRAP;
+        pushIndex(&traps->indices, &traps->count, &traps->capacity, index);
+    }
+}
+
+/// @brief Puts back every instruction that was replaced with a trap.
+/// @param program the program
+/// @param traps the traps patched into the program
+void bfClearTraps(Program *program, Traps *traps) {
+    for (int i = 0; i < traps->count; ++i) {
+        program->instructions[traps->indices[i]].op = traps->savedOps[traps->indices[i]];
+    }
+    traps->count = 0;
+}
+
+/// @brief Gets the operation of an instruction, looking past any trap on it.
+/// @param program the program
+/// @param traps the traps patched into the program
+/// @param index the index of the instruction
+/// @return the operation
+OpCode bfOriginalOp(Program *program, Traps *traps, int index) {
+    OpCode op = program->instructions[index].op;
+    return op == OP_TRAP ? traps->savedOps[index] : op;
+}
+
+/// @brief Adds a watchpoint from a description of it.
+/// @param watches the watchpoints to add it to
+/// @param description the tape index of the cell, optionally followed by
+///        ':' and the value to stop at, like "12" or "12:65"
+/// @return true if the description is valid
+bool bfAddWatch(Watches *watches, const char *description) {
+    char *end;
+    long tapeIndex = strtol(description, &end, 10);
+    if (end == description || tapeIndex < INT_MIN || tapeIndex > INT_MAX) {
+        return false;
+    }
+    long value = -1;
+    if (*end == ':') {
+        const char *valueStart = end + 1;
+        value = strtol(valueStart, &end, 10);
+        if (end == valueStart || value < 0 || value > UCHAR_MAX) {
+            return false;
+        }
+    }
+    while (isspace((unsigned char) *end)) {
+        ++end;
+    }
+    if (*end != '\0') {
+        return false;
+    }
+
+    if (watches->count >= watches->capacity) {
+        watches->capacity = watches->capacity == 0 ? 4 : watches->capacity * 2;
+        watches->list = realloc(watches->list, watches->capacity * sizeof(Watch));
+    }
+    watches->list[watches->count++] = (Watch) {tapeIndex, value};
+    return true;
+}
+
+/// @brief Checks whether a write to a cell sets off a watchpoint, remembering
+///        which one it was if it does.
+/// @param watches the watchpoints
+/// @param tapeIndex the tape index of the cell that was written to
+/// @param before the value of the cell before the write
+/// @param after the value of the cell after the write
+/// @return true if the engine should stop
+static inline bool watchTriggered(Watches *watches, int tapeIndex, CellValue before, CellValue after) {
+    if (before == after) {
+        return false;
+    }
+    for (int i = 0; i < watches->count; ++i) {
+        if (watches->list[i].tapeIndex == tapeIndex && (watches->list[i].value < 0 || watches->list[i].value == after)) {
+            watches->hit = i;
+            watches->previous = before;
+            watches->current = after;
+            return true;
+        }
+    }
+    return false;
+}
+
+/// The most steps the engines without traps run between looks at the clock
+/// when the machine has a deadline.
+#define DEADLINE_CHECK_STEPS (1 << 22)
+
+/// @brief Works out how many steps an engine without traps can run before it
+///        next has to check the machine's step limit and deadline.
+/// @param machine the machine
+/// @return the number of steps
+static long long stepsUntilCheck(BFMachine *machine) {
+    unsigned long long steps = machine->steps < machine->stepLimit ? machine->stepLimit - machine->steps : 0;
+    if (machine->deadline > 0 && steps > DEADLINE_CHECK_STEPS) {
+        steps = DEADLINE_CHECK_STEPS;
+    }
+    return steps > LLONG_MAX ? LLONG_MAX : (long long) steps;
+}
+
+/// @brief Counts the steps an engine without traps ran since its last check
+///        in the machine's steps, and checks the machine's step limit and
+///        deadline once the engine has run all of the steps it could.
+/// @param machine the machine
+/// @param stepsLeft the steps the engine has left before its next check,
+///        which is set to the steps it has left after this one
+/// @param stepsAtCheck the steps the engine had left right after its last
+///        check, which is set to the same
+/// @return true if the engine can keep going, false if it has to stop
+static bool withinLimits(BFMachine *machine, long long *stepsLeft, long long *stepsAtCheck) {
+    machine->steps += *stepsAtCheck - *stepsLeft;
+    *stepsAtCheck = *stepsLeft;
+    if (machine->steps > machine->stepLimit) {
+        machine->stopReason = STOP_STEP_LIMIT;
+        return false;
+    }
+    if (machine->deadline > 0 && bfNanoseconds() >= machine->deadline) {
+        machine->stopReason = STOP_DEADLINE;
+        return false;
+    }
+    *stepsLeft = *stepsAtCheck = stepsUntilCheck(machine);
+    return true;
+}
+
+// Traces, which record every step a program runs so that any of them can be
+// looked at later without running the program again. Each record is a run of
+// steps in a row that did the same thing, with the position in the BF code
+// and the tape head stored as deltas, so that loops turn into the same few
+// bytes over and over. Those bytes are then compressed a block at a time.
+//
+// A trace file starts with TRACE_MAGIC and a byte of flags, followed by the
+// blocks, each of which is its length before and after compressing (4 bytes
+// each, least significant first) and then the block itself. A block whose
+// two lengths are the same wasn't compressed.
+
+/// The first bytes of every trace file, which also give its version.
+static const char TRACE_MAGIC[] = "BFTRACE1";
+
+/// The flag set in a trace file when the output was written as bytes.
+#define TRACE_RAW_OUTPUT 1
+
+/// The most bytes a single record can take up.
+#define MAX_TRACE_RECORD_LENGTH 32
+
+/// The most bytes a compressed block can take up, if nothing in it repeats.
+#define MAX_COMPRESSED_BLOCK_SIZE (2 * TRACE_BLOCK_SIZE)
+
+/// The number of bits of the hash the compressor looks up earlier bytes by.
+#define TRACE_HASH_BITS 12
+
+/// The shortest run of bytes the compressor copies from earlier in a block.
+#define MIN_TRACE_MATCH 4
+
+/// @brief Writes out a number as 7 bits per byte, least significant first,
+///        with the top bit set on every byte but the last.
+/// @param out where to write it
+/// @param index the index in out to write it at
+/// @param value the number
+/// @return the index just past it
+static size_t putVarint(unsigned char *out, size_t index, unsigned long long value) {
+    while (value >= 0x80) {
+        out[index++] = (unsigned char) (value | 0x80);
+        value >>= 7;
+    }
+    out[index++] = (unsigned char) value;
+    return index;
+}
+
+/// @brief Reads a number written by putVarint().
+/// @param in the bytes to read from
+/// @param length the number of bytes
+/// @param index the address of the index of the number, which is moved past it
+/// @param value where to put the number
+/// @return false if the number runs past the end of the bytes
+static bool getVarint(const unsigned char *in, size_t length, size_t *index, unsigned long long *value) {
+    *value = 0;
+    for (int shift = 0; shift < 64; shift += 7) {
+        if (*index == length) {
+            return false;
+        }
+        const unsigned char byte = in[(*index)++];
+        *value |= (unsigned long long) (byte & 0x7F) << shift;
+        if (byte < 0x80) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/// @brief Maps a signed number to an unsigned one that is small when the
+///        number is close to 0, so that putVarint() keeps it short.
+static unsigned long long zigzag(long long value) {
+    return ((unsigned long long) value << 1) ^ (unsigned long long) (value >> 63);
+}
+
+/// @brief Undoes zigzag().
+static long long unzigzag(unsigned long long value) {
+    return (long long) (value >> 1) ^ -(long long) (value & 1);
+}
+
+/// @brief Compresses a block with a simple LZ77 scheme: runs of bytes that
+///        are copied as they are, each followed by a match that repeats
+///        bytes from earlier in the block, found through a hash table of
+///        the last place every MIN_TRACE_MATCH bytes were seen.
+/// @param in the block
+/// @param length the number of bytes in the block
+/// @param out where to write the compressed block, which needs room for
+///        MAX_COMPRESSED_BLOCK_SIZE bytes
+/// @return the number of bytes of the compressed block
+static size_t compressBlock(const unsigned char *in, size_t length, unsigned char *out) {
+    // The index just past the last place each hash was seen, or 0 for none.
+    size_t seen[1 << TRACE_HASH_BITS] = {0};
+    size_t written = 0;
+    size_t literals = 0;
+    size_t i = 0;
+    while (i + MIN_TRACE_MATCH <= length) {
+        const unsigned int sequence = in[i] | in[i + 1] << 8 | in[i + 2] << 16 | (unsigned int) in[i + 3] << 24;
+        const unsigned int hash = (sequence * 2654435761u) >> (32 - TRACE_HASH_BITS);
+        const size_t candidate = seen[hash];
+        seen[hash] = i + 1;
+        if (candidate == 0 || memcmp(&in[candidate - 1], &in[i], MIN_TRACE_MATCH) != 0) {
+            ++i;
+            continue;
+        }
+        const size_t match = candidate - 1;
+        size_t matchLength = MIN_TRACE_MATCH;
+        while (i + matchLength < length && in[match + matchLength] == in[i + matchLength]) {
+            ++matchLength;
+        }
+        written = putVarint(out, written, i - literals);
+        memcpy(&out[written], &in[literals], i - literals);
+        written += i - literals;
+        written = putVarint(out, written, matchLength - MIN_TRACE_MATCH);
+        written = putVarint(out, written, i - match);
+        i += matchLength;
+        literals = i;
+    }
+    if (literals < length) {
+        written = putVarint(out, written, length - literals);
+        memcpy(&out[written], &in[literals], length - literals);
+        written += length - literals;
+    }
+    return written;
+}
+
+/// @brief Undoes compressBlock(), checking that the block makes sense.
+/// @param in the compressed block
+/// @param length the number of bytes of the compressed block
+/// @param out where to write the block
+/// @param outLength the number of bytes of the block
+/// @return false if the compressed block is broken
+static bool decompressBlock(const unsigned char *in, size_t length, unsigned char *out, size_t outLength) {
+    size_t i = 0;
+    size_t written = 0;
+    while (written < outLength) {
+        unsigned long long count;
+        if (!getVarint(in, length, &i, &count) || count > length - i || count > outLength - written) {
+            return false;
+        }
+        memcpy(&out[written], &in[i], count);
+        i += count;
+        written += count;
+        if (written == outLength) {
+            break;
+        }
+        unsigned long long matchLength;
+        unsigned long long distance;
+        if (!getVarint(in, length, &i, &matchLength) || !getVarint(in, length, &i, &distance)) {
+            return false;
+        }
+        matchLength += MIN_TRACE_MATCH;
+        if (distance == 0 || distance > written || matchLength > outLength - written) {
+            return false;
+        }
+        // The match can overlap the bytes it writes, so it is copied a byte at a time.
+        for (size_t j = 0; j < matchLength; ++j, ++written) {
+            out[written] = out[written - distance];
+        }
+    }
+    return i == length;
+}
+
+/// @brief Writes out a number as 4 bytes, least significant first.
+/// @param trace the trace to write it to
+/// @param value the number
+static void putTraceLength(TraceWriter *trace, size_t value) {
+    const unsigned char bytes[4] = {value, value >> 8, value >> 16, value >> 24};
+    if (fwrite(bytes, 1, 4, trace->file) != 4) {
+        trace->failed = true;
+    }
+}
+
+/// @brief Compresses the records in the block of a trace and writes them
+///        out, leaving the block empty.
+/// @param trace the trace
+static void writeTraceBlock(TraceWriter *trace) {
+    if (trace->used == 0) {
+        return;
+    }
+    size_t length = compressBlock(trace->block, trace->used, trace->compressed);
+    const unsigned char *data = trace->compressed;
+    if (length >= trace->used) {
+        length = trace->used;
+        data = trace->block;
+    }
+    putTraceLength(trace, trace->used);
+    putTraceLength(trace, length);
+    if (fwrite(data, 1, length, trace->file) != length) {
+        trace->failed = true;
+    }
+    trace->used = 0;
+}
+
+/// @brief Puts the pending steps of a trace in its block, writing out the
+///        block first if they might not fit.
+/// @param trace the trace
+static void writeTraceRecord(TraceWriter *trace) {
+    const TraceRecord *record = &trace->pending;
+    if (trace->used + MAX_TRACE_RECORD_LENGTH > TRACE_BLOCK_SIZE) {
+        writeTraceBlock(trace);
+    }
+    unsigned char *block = trace->block;
+    size_t used = trace->used;
+    block[used++] = record->kind;
+    used = putVarint(block, used, record->count);
+    used = putVarint(block, used, zigzag(record->posDelta));
+    switch (record->kind) {
+        case TRACE_MOVE:
+            used = putVarint(block, used, zigzag(record->value));
+            break;
+        case TRACE_WRITE:
+        case TRACE_IN:
+        case TRACE_OUT:
+            used = putVarint(block, used, zigzag(record->offset));
+            block[used++] = (CellValue) record->value;
+            break;
+        case TRACE_STEP:
+        case TRACE_STOP:
+            break;
+    }
+    trace->used = used;
+}
+
+/// @brief Records a step in a trace, which only counts it if the step
+///        before it did the same thing.
+/// @param trace the trace
+/// @param kind what the step did
+/// @param pos the index into the BF code of the instruction the step ran
+/// @param offset the offset from the tape head of the cell the step used
+/// @param value the value the step moved by, added, read or output
+static inline void recordTraceEvent(TraceWriter *trace, TraceKind kind, int pos, int offset, int value) {
+    TraceRecord *pending = &trace->pending;
+    const int posDelta = pos - trace->pos;
+    trace->pos = pos;
+    if (pending->kind == kind && pending->posDelta == posDelta &&
+        pending->offset == offset && pending->value == value && pending->count > 0) {
+        ++pending->count;
+        return;
+    }
+    if (pending->count > 0) {
+        writeTraceRecord(trace);
+    }
+    *pending = (TraceRecord) {kind, posDelta, offset, value, 1};
+}
+
+/// @brief Starts recording a trace to a file.
+/// @param fileName the name of the file
+/// @param rawOutput whether the output is written as bytes instead of in decimal
+/// @return the trace, or NULL if the file couldn't be written to
+TraceWriter *bfOpenTraceWriter(const char *fileName, bool rawOutput) {
+    FILE *file = fopen(fileName, "wb");
+    if (file == NULL) {
+        return NULL;
+    }
+    const unsigned char flags = rawOutput ? TRACE_RAW_OUTPUT : 0;
+    if (fwrite(TRACE_MAGIC, 1, sizeof(TRACE_MAGIC) - 1, file) != sizeof(TRACE_MAGIC) - 1 ||
+        fwrite(&flags, 1, 1, file) != 1) {
+        fclose(file);
+        return NULL;
+    }
+    TraceWriter *trace = calloc(1, sizeof(TraceWriter));
+    trace->file = file;
+    trace->block = malloc(TRACE_BLOCK_SIZE);
+    trace->compressed = malloc(MAX_COMPRESSED_BLOCK_SIZE);
+    return trace;
+}
+
+/// @brief Writes out the rest of a trace and closes its file. The trace
+///        should end with a TRACE_STOP, which bfRunTraced() records.
+/// @param trace the trace
+/// @return false if any of the trace couldn't be written out
+bool bfCloseTraceWriter(TraceWriter *trace) {
+    if (trace->pending.count > 0) {
+        writeTraceRecord(trace);
+    }
+    writeTraceBlock(trace);
+    bool written = !trace->failed;
+    if (fclose(trace->file) != 0) {
+        written = false;
+    }
+    free(trace->block);
+    free(trace->compressed);
+    free(trace);
+    return written;
+}
+
+// The execution engines, which only differ in how they dispatch instructions.
+
+#define ENGINE_NAME executeSwitch
+#define ENGINE_THREADED 0
+#include "engine.h"
+
+#define ENGINE_NAME executeSwitchUnchecked
+#define ENGINE_THREADED 0
+#define ENGINE_BOUNDS_CHECKS 0
+#include "engine.h"
+
+#if defined(__GNUC__)
+#define HAS_COMPUTED_GOTO 1
+#define ENGINE_NAME executeThreaded
+#define ENGINE_THREADED 1
+#include "engine.h"
+
+#define ENGINE_NAME executeThreadedUnchecked
+#define ENGINE_THREADED 1
+#define ENGINE_BOUNDS_CHECKS 0
+#include "engine.h"
+#else
+#define HAS_COMPUTED_GOTO 0
+#endif
+
+#define ENGINE_NAME executeProfiled
+#define ENGINE_THREADED HAS_COMPUTED_GOTO
+#define ENGINE_PROFILE 1
+#include "engine.h"
+
+#define ENGINE_NAME executeUntilTrap
+#define ENGINE_THREADED HAS_COMPUTED_GOTO
+#define ENGINE_TRAPS 1
+#define ENGINE_STEPS 1
+#include "engine.h"
+
+#define ENGINE_NAME executeUntilWatch
+#define ENGINE_THREADED HAS_COMPUTED_GOTO
+#define ENGINE_TRAPS 1
+#define ENGINE_WATCH 1
+#define ENGINE_STEPS 1
+#include "engine.h"
+
+#define ENGINE_NAME executeTraced
+#define ENGINE_THREADED HAS_COMPUTED_GOTO
+#define ENGINE_TRAPS 1
+#define ENGINE_STEPS 1
+#define ENGINE_TRACE 1
+#include "engine.h"
+
+/// The fastest bytecode engine available, used when the JIT can't be.
+#if HAS_COMPUTED_GOTO
+#define executeBytecode executeThreaded
+#define executeBytecodeUnchecked executeThreadedUnchecked
+#else
+#define executeBytecode executeSwitch
+#define executeBytecodeUnchecked executeSwitchUnchecked
+#endif
+
+#if HAS_JIT
+
+/// @brief The state that JIT compiled code shares with the functions it calls.
+typedef struct {
+    /// The first cell of the tape, kept in r13 by the compiled code.
+    CellValue *low;
+    /// One past the last cell of the tape, kept in r14 by the compiled code.
+    CellValue *high;
+    /// The machine the compiled code runs on.
+    BFMachine *machine;
+    /// The machine's tape.
+    Tape *tape;
+    /// How far the program reaches from the tape head.
+    int reach;
+    /// The steps left before the next check of the machine's limits, which
+    /// the compiled code keeps in r15 and only saves here around the check.
+    long long stepsLeft;
+    /// The steps that were left right after the last check.
+    long long stepsAtCheck;
+} JitContext;
+
+/// @brief JIT compiled code, which is called with the current tape cell and
+///        the JIT context, and returns the tape cell it finished on.
+typedef CellValue *(*JitFunction)(CellValue *cell, JitContext *context);
+
+/// @brief x86-64 machine code being put together by the JIT.
+typedef struct {
+    unsigned char *bytes;
+    size_t count;
+    size_t capacity;
+} MachineCode;
+
+/// @brief Appends bytes to the machine code.
+/// @param code the machine code
+/// @param bytes the bytes to append
+/// @param count the number of bytes
+static void emitBytes(MachineCode *code, const void *bytes, size_t count) {
+    while (code->count + count > code->capacity) {
+        code->capacity = code->capacity == 0 ? BUFFER_SIZE : code->capacity * 2;
+        code->bytes = realloc(code->bytes, code->capacity);
+    }
+    memcpy(&code->bytes[code->count], bytes, count);
+    code->count += count;
+}
+
+/// Appends the given bytes to the machine code.
+#define EMIT(code, ...)                                                       \
+    do {                                                                      \
+        const unsigned char emitted[] = {__VA_ARGS__};                        \
+        emitBytes((code), emitted, sizeof(emitted));                          \
+    } while (0)
+
+/// @brief Appends a 32-bit little endian value to the machine code.
+static void emitInt32(MachineCode *code, int value) {
+    emitBytes(code, &value, 4);
+}
+
+/// @brief Appends a call to a C function to the machine code.
+/// @param code the machine code
+/// @param function the address of the function
+static void emitCall(MachineCode *code, void *function) {
+    EMIT(code, 0x48, 0xB8);                 // mov rax, function
+    emitBytes(code, &function, 8);
+    EMIT(code, 0xFF, 0xD0);                 // call rax
+}
+
+/// @brief Appends a conditional jump with a 32-bit displacement to be patched later.
+/// @param code the machine code
+/// @param condition the second opcode byte of the jump (0x82 jb, 0x83 jae, 0x84 je, 0x85 jne)
+/// @return the position of the displacement
+static size_t emitJump(MachineCode *code, unsigned char condition) {
+    EMIT(code, 0x0F, condition);
+    emitInt32(code, 0);
+    return code->count - 4;
+}
+
+/// @brief Points a jump's displacement at the given position in the machine code.
+/// @param code the machine code
+/// @param displacement the position of the jump's displacement
+/// @param target the position to jump to
+static void patchJump(MachineCode *code, size_t displacement, size_t target) {
+    int relative = (int) (target - (displacement + 4));
+    memcpy(&code->bytes[displacement], &relative, 4);
+}
+
+/// @brief Appends code to reload the tape bounds in r13 and r14 from the context.
+static void emitReloadBounds(MachineCode *code) {
+    EMIT(code, 0x4D, 0x8B, 0x6C, 0x24, offsetof(JitContext, low));   // mov r13, [r12 + low]
+    EMIT(code, 0x4D, 0x8B, 0x74, 0x24, offsetof(JitContext, high));  // mov r14, [r12 + high]
+}
+
+/// @brief Sets the tape index from a cell pointer of the compiled code.
+static void jitSyncTapeIndex(JitContext *context, CellValue *cell) {
+    context->tape->head = (int) (cell - context->tape->cells) - context->tape->origin;
+}
+
+/// @brief Updates the tape bounds the compiled code checks the tape head
+///        against, which leave room for every cell the program reaches.
+static void jitUpdateBounds(JitContext *context) {
+    context->low = context->tape->cells + context->reach;
+    context->high = context->tape->cells + context->tape->capacity - context->reach;
+}
+
+/// @brief Grows the tape after the compiled code moved the head too close to an end.
+/// @return the new address of the current cell
+static CellValue *jitGrow(JitContext *context, CellValue *cell) {
+    jitSyncTapeIndex(context, cell);
+    cell = reachCells(context->machine, context->reach);
+    jitUpdateBounds(context);
+    return cell;
+}
+
+/// @brief Outputs a cell value for the compiled code.
+static void jitOut(JitContext *context, int value) {
+    outputValue(context->machine, value);
+}
+
+/// @brief Reads an input value into a cell for the compiled code.
+static void jitIn(JitContext *context, CellValue *cell) {
+    *cell = readValue(context->machine->input);
+}
+
+/// @brief Checks the machine's limits for the compiled code once it has run
+///        all of the steps it could before checking them.
+/// @param context the JIT context, with the steps left saved in it
+/// @param index the index of the instruction the check is at
+/// @return true if the compiled code can keep going
+static bool jitCheckLimits(JitContext *context, int index) {
+    if (withinLimits(context->machine, &context->stepsLeft, &context->stepsAtCheck)) {
+        return true;
+    }
+    context->machine->stoppedAt = index;
+    return false;
+}
+
+/// @brief Runs a scan loop for the compiled code.
+/// @return the address of the cell the scan stopped at
+static CellValue *jitScan(JitContext *context, CellValue *cell, int stride) {
+    Tape *tape = context->tape;
+    int position = context->machine->scan(tape->cells, tape->capacity, (int) (cell - tape->cells), stride);
+    tape->head = position - tape->origin;
+    cell = reachCells(context->machine, context->reach);
+    jitUpdateBounds(context);
+    return cell;
+}
+
+/// @brief Appends code that calls one of the jit functions above taking
+///        (context, cell, edx) and returning the new current cell.
+static void emitCellCall(MachineCode *code, void *function) {
+    EMIT(code, 0x4C, 0x89, 0xE7);           // mov rdi, r12
+    EMIT(code, 0x48, 0x89, 0xDE);           // mov rsi, rbx
+    emitCall(code, function);
+    EMIT(code, 0x48, 0x89, 0xC3);           // mov rbx, rax
+    emitReloadBounds(code);
+}
+
+/// @brief Appends the ModRM byte (and displacement) of an operand that is the
+///        cell at an offset from the current cell in rbx.
+/// @param code the machine code
+/// @param reg the register (or opcode extension) in the reg field
+/// @param offset the offset
+static void emitCellOperand(MachineCode *code, int reg, int offset) {
+    if (offset == 0) {
+        EMIT(code, (unsigned char) (reg << 3 | 0x03));  // [rbx]
+    } else {
+        EMIT(code, (unsigned char) (0x80 | reg << 3 | 0x03));  // [rbx + offset]
+        emitInt32(code, offset);
+    }
+}
+
+/// @brief Appends code that checks the machine's limits if the steps left in
+///        r15 have run out, with the flags already set from r15, and leaves
+///        the compiled code if they say it has to stop.
+/// @param code the machine code
+/// @param index the index of the instruction the check is at
+/// @param exits the positions of the jumps to the exit, to add this one to
+/// @param exitCount the number of jumps to the exit
+/// @param exitCapacity the room for jumps to the exit
+static void emitLimitCheck(MachineCode *code, int index, int **exits, int *exitCount, int *exitCapacity) {
+    size_t done = emitJump(code, 0x89);     // jns done
+    EMIT(code, 0x4D, 0x89, 0x7C, 0x24, offsetof(JitContext, stepsLeft));  // mov [r12 + stepsLeft], r15
+    EMIT(code, 0x4C, 0x89, 0xE7);           // mov rdi, r12
+    EMIT(code, 0xBE);                       // mov esi, index
+    emitInt32(code, index);
+    emitCall(code, (void *) jitCheckLimits);
+    EMIT(code, 0x4D, 0x8B, 0x7C, 0x24, offsetof(JitContext, stepsLeft));  // mov r15, [r12 + stepsLeft]
+    EMIT(code, 0x84, 0xC0);                 // test al, al
+    pushIndex(exits, exitCount, exitCapacity, (int) emitJump(code, 0x84));  // je exit
+    patchJump(code, done, code->count);
+}
+
+/// @brief Appends the code that returns from the compiled code with the
+///        current cell, and points the jumps to the exit at it.
+/// @param code the machine code
+/// @param exits the positions of the jumps to the exit
+/// @param exitCount the address of the number of jumps to the exit, which is reset
+static void emitExit(MachineCode *code, int *exits, int *exitCount) {
+    for (int j = 0; j < *exitCount; ++j) {
+        patchJump(code, exits[j], code->count);
+    }
+    *exitCount = 0;
+    EMIT(code, 0x4D, 0x89, 0x7C, 0x24, offsetof(JitContext, stepsLeft));  // mov [r12 + stepsLeft], r15
+    EMIT(code, 0x48, 0x89, 0xD8);           // mov rax, rbx
+    EMIT(code, 0x41, 0x5F, 0x41, 0x5E, 0x41, 0x5D, 0x41, 0x5C, 0x5B);  // pop r15-r12, rbx
+    EMIT(code, 0xC3);                       // ret
+}
+
+/// @brief Compiles the instructions of a program from first up to last to
+///        x86-64 machine code, which is either the whole program or the
+///        body of a loop, up to and including its OP_JNZ. The compiled code
+///        keeps the current cell in rbx, the context in r12, the tape bounds
+///        in r13 and r14 and the steps left before the next check of the
+///        machine's limits in r15, and calls back into C for I/O, to grow
+///        the tape and to check the limits. The code for a loop returns once
+///        the loop ends.
+/// @param program the compiled program
+/// @param first the index of the first instruction to compile
+/// @param last the index one past the last instruction to compile
+/// @param boundsChecks whether to check for the tape head leaving the tape,
+///        which can only be left out for virtual tapes
+/// @param size the address to store the size of the executable mapping in
+/// @return the compiled code, or NULL if it could not be made executable
+static JitFunction jitCompile(Program *program, int first, int last, bool boundsChecks, size_t *size) {
+    MachineCode code = {0};
+    // The positions of the instructions and their jumps, from first on.
+    size_t *starts = malloc((last - first + 1) * sizeof(size_t));
+    size_t *jumps = malloc((last - first) * sizeof(size_t));
+    int *exits = NULL;
+    int exitCount = 0;
+    int exitCapacity = 0;
+
+    // Prologue
+    EMIT(&code, 0x53, 0x41, 0x54, 0x41, 0x55, 0x41, 0x56, 0x41, 0x57);  // push rbx, r12-r15
+    EMIT(&code, 0x48, 0x89, 0xFB);          // mov rbx, rdi
+    EMIT(&code, 0x49, 0x89, 0xF4);          // mov r12, rsi
+    emitReloadBounds(&code);
+    EMIT(&code, 0x4D, 0x8B, 0x7C, 0x24, offsetof(JitContext, stepsLeft));  // mov r15, [r12 + stepsLeft]
+
+    for (int i = first; i < last; ++i) {
+        Instruction *instruction = &program->instructions[i];
+        size_t skip;
+        size_t done;
+        starts[i - first] = code.count;
+        // Superinstructions compile as their first instruction, followed by the second.
+        const OpCode op = bfBaseOp(instruction->op);
+        switch (op) {
+            case OP_ADD:
+                EMIT(&code, 0x80);              // add byte [rbx + offset], arg
+                emitCellOperand(&code, 0, instruction->offset);
+                EMIT(&code, (unsigned char) instruction->arg);
+                break;
+            case OP_MOVE:
+                EMIT(&code, 0x48, 0x81, 0xC3);  // add rbx, arg
+                emitInt32(&code, instruction->arg);
+                if (!boundsChecks) {
+                    break;
+                }
+                if (instruction->arg > 0) {
+                    EMIT(&code, 0x4C, 0x39, 0xF3);  // cmp rbx, r14
+                    done = emitJump(&code, 0x82);   // jb done
+                } else {
+                    EMIT(&code, 0x4C, 0x39, 0xEB);  // cmp rbx, r13
+                    done = emitJump(&code, 0x83);   // jae done
+                }
+                emitCellCall(&code, (void *) jitGrow);
+                patchJump(&code, done, code.count);
+                break;
+            case OP_OUT:
+                EMIT(&code, 0x49, 0x81, 0xEF);  // sub r15, steps
+                emitInt32(&code, instruction->steps);
+                emitLimitCheck(&code, i, &exits, &exitCount, &exitCapacity);
+                EMIT(&code, 0x4C, 0x89, 0xE7);  // mov rdi, r12
+                EMIT(&code, 0x0F, 0xB6);        // movzx esi, byte [rbx + offset]
+                emitCellOperand(&code, 6, instruction->offset);
+                emitCall(&code, (void *) jitOut);
+                break;
+            case OP_IN:
+                EMIT(&code, 0x49, 0x81, 0xEF);  // sub r15, steps
+                emitInt32(&code, instruction->steps);
+                emitLimitCheck(&code, i, &exits, &exitCount, &exitCapacity);
+                EMIT(&code, 0x4C, 0x89, 0xE7);  // mov rdi, r12
+                EMIT(&code, 0x48, 0x8D);        // lea rsi, [rbx + offset]
+                emitCellOperand(&code, 6, instruction->offset);
+                emitCall(&code, (void *) jitIn);
+                break;
+            case OP_JZ:
+            case OP_JNZ:
+                EMIT(&code, 0x49, 0x81, 0xEF);  // sub r15, steps
+                emitInt32(&code, instruction->steps);
+                if (op == OP_JNZ) {
+                    // Only a jump back to the start of the loop checks the limits.
+                    done = emitJump(&code, 0x89);   // jns done
+                    EMIT(&code, 0x80, 0x3B, 0x00);  // cmp byte [rbx], 0
+                    skip = emitJump(&code, 0x84);   // je done
+                    EMIT(&code, 0x4D, 0x85, 0xFF);  // test r15, r15
+                    emitLimitCheck(&code, i, &exits, &exitCount, &exitCapacity);
+                    patchJump(&code, done, code.count);
+                    patchJump(&code, skip, code.count);
+                }
+                EMIT(&code, 0x80, 0x3B, 0x00);  // cmp byte [rbx], 0
+                jumps[i - first] = emitJump(&code, op == OP_JZ ? 0x84 : 0x85);  // je/jne target
+                break;
+            case OP_SET:
+                EMIT(&code, 0xC6);              // mov byte [rbx + offset], arg
+                emitCellOperand(&code, 0, instruction->offset);
+                EMIT(&code, (unsigned char) instruction->arg);
+                break;
+            case OP_MUL:
+                EMIT(&code, 0x80, 0x3B, 0x00);  // cmp byte [rbx], 0
+                skip = emitJump(&code, 0x84);   // je skip
+                EMIT(&code, 0x0F, 0xB6, 0x03);  // movzx eax, byte [rbx]
+                if (instruction->arg != 1) {
+                    EMIT(&code, 0x69, 0xC0);    // imul eax, eax, arg
+                    emitInt32(&code, instruction->arg);
+                }
+                EMIT(&code, 0x00);              // add byte [rbx + offset], al
+                emitCellOperand(&code, 0, instruction->offset);
+                patchJump(&code, skip, code.count);
+                break;
+            case OP_PRODUCT:
+                EMIT(&code, 0x80, 0x3B, 0x00);  // cmp byte [rbx], 0
+                skip = emitJump(&code, 0x84);   // je skip
+                EMIT(&code, 0x0F, 0xB6, 0x03);  // movzx eax, byte [rbx]
+                EMIT(&code, 0x0F, 0xB6);        // movzx ecx, byte [rbx + source]
+                emitCellOperand(&code, 1, PRODUCT_SOURCE(instruction->arg));
+                EMIT(&code, 0x0F, 0xAF, 0xC1);  // imul eax, ecx
+                if (PRODUCT_FACTOR(instruction->arg) != 1) {
+                    EMIT(&code, 0x69, 0xC0);    // imul eax, eax, factor
+                    emitInt32(&code, PRODUCT_FACTOR(instruction->arg));
+                }
+                EMIT(&code, 0x00);              // add byte [rbx + offset], al
+                emitCellOperand(&code, 0, instruction->offset);
+                patchJump(&code, skip, code.count);
+                break;
+            case OP_SCAN:
+                EMIT(&code, 0x80, 0x3B, 0x00);  // cmp byte [rbx], 0
+                skip = emitJump(&code, 0x84);   // je skip
+                EMIT(&code, 0xBA);              // mov edx, stride
+                emitInt32(&code, instruction->arg);
+                emitCellCall(&code, (void *) jitScan);
+                patchJump(&code, skip, code.count);
+                break;
+            case OP_TRAP:  // Traps are only ever patched into programs in the visual mode.
+            case OP_END:
+                EMIT(&code, 0x49, 0x81, 0xEF);  // sub r15, steps
+                emitInt32(&code, instruction->steps);
+                emitExit(&code, exits, &exitCount);
+                break;
+            default:  // bfBaseOp() never gives a superinstruction.
+                break;
+        }
+    }
+    starts[last - first] = code.count;
+    if (program->instructions[last - 1].op != OP_END) {
+        emitExit(&code, exits, &exitCount);
+    }
+
+    // Now that every instruction has a position the jumps can be resolved.
+    for (int i = first; i < last; ++i) {
+        OpCode op = program->instructions[i].op;
+        if (op == OP_JZ || op == OP_JNZ) {
+            patchJump(&code, jumps[i - first], starts[program->instructions[i].arg - first]);
+        }
+    }
+
+    // Copy the code into memory that is executable but no longer writable.
+    JitFunction result = NULL;
+    void *memory = mmap(NULL, code.count, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (memory != MAP_FAILED) {
+        memcpy(memory, code.bytes, code.count);
+        if (mprotect(memory, code.count, PROT_READ | PROT_EXEC) == 0) {
+            result = (JitFunction) memory;
+            *size = code.count;
+        } else {
+            munmap(memory, code.count);
+        }
+    }
+
+    free(code.bytes);
+    free(starts);
+    free(jumps);
+    free(exits);
+    return result;
+}
+
+/// @brief Executes a compiled program as native x86-64 code, falling back
+///        to the bytecode engine if the code can't be made executable.
+/// @param machine the machine to run the program on
+/// @param boundsChecks whether to check for the tape head leaving the tape
+static void runJIT(BFMachine *machine, bool boundsChecks) {
+    size_t size;
+    JitFunction function = jitCompile(machine->program, 0, machine->program->count, boundsChecks, &size);
+    if (function == NULL) {
+        if (boundsChecks) {
+            executeBytecode(machine);
+        } else {
+            executeBytecodeUnchecked(machine);
+        }
+        return;
+    }
+    JitContext context = {NULL, NULL, machine, &machine->tape, boundsChecks ? machine->program->reach : 0, 0, 0};
+    context.stepsLeft = context.stepsAtCheck = stepsUntilCheck(machine);
+    machine->stopReason = STOP_END;
+    // The compiled code has to be unmapped even if the run stops short.
+    CATCH_STOP(machine, {
+        CellValue *cell = reachCells(machine, context.reach);
+        jitUpdateBounds(&context);
+        cell = function(cell, &context);
+        jitSyncTapeIndex(&context, cell);
+        machine->steps += context.stepsAtCheck - context.stepsLeft;
+    });
+    munmap((void *) function, size);
+}
+
+/// @brief Executes a compiled program as native x86-64 code.
+static void executeJIT(BFMachine *machine) {
+    runJIT(machine, true);
+}
+
+/// @brief Executes a compiled program as native x86-64 code without any
+///        tape bounds checks, which only works on a virtual tape.
+static void executeJITUnchecked(BFMachine *machine) {
+    runJIT(machine, false);
+}
+
+/// The number of times a loop has to jump back to its start before the
+/// tiered engine compiles it.
+#define HOT_LOOP_BACK_EDGES 1024
+
+/// @brief The loops the tiered engine has counted and compiled so far, all
+///        by the index of the first instruction of the loop's body.
+typedef struct {
+    /// The number of times each loop jumped back to the start of its body.
+    int *backEdges;
+    /// The compiled code of each hot loop, or NULL.
+    JitFunction *loops;
+    /// The size of the executable mapping of each hot loop's code.
+    size_t *sizes;
+    /// Whether the compiled code checks for the tape head leaving the tape.
+    bool boundsChecks;
+} Tiers;
+
+/// @brief Compiles a loop that got hot for the tiered engine, which just
+///        keeps running it as bytecode if it can't be compiled.
+/// @param tiers the loops the tiered engine has compiled
+/// @param program the compiled program
+/// @param body the index of the first instruction of the loop's body
+static void compileHotLoop(Tiers *tiers, Program *program, int body) {
+    int end = program->instructions[body - 1].arg;
+    tiers->loops[body] = jitCompile(program, body, end, tiers->boundsChecks, &tiers->sizes[body]);
+}
+
+/// @brief Runs a hot loop as compiled code for the tiered engine, from the
+///        start of its body until it ends (or the machine's limits stop it).
+/// @param tiers the loops the tiered engine has compiled
+/// @param machine the machine to run the loop on
+/// @param body the index of the first instruction of the loop's body
+/// @param cell the current cell
+/// @param stepsLeft the address of the steps the engine has left before its
+///        next check, which is set to the steps left after the loop
+/// @param stepsAtCheck the address of the steps the engine had left right
+///        after its last check, which is set to the same after the loop
+/// @return the current cell after the loop
+static CellValue *runHotLoop(
+        Tiers *tiers,
+        BFMachine *machine,
+        int body,
+        CellValue *cell,
+        long long *stepsLeft,
+        long long *stepsAtCheck) {
+    int reach = tiers->boundsChecks ? machine->program->reach : 0;
+    JitContext context = {NULL, NULL, machine, &machine->tape, reach, *stepsLeft, *stepsAtCheck};
+    jitUpdateBounds(&context);
+    cell = tiers->loops[body](cell, &context);
+    jitSyncTapeIndex(&context, cell);
+    *stepsLeft = context.stepsLeft;
+    *stepsAtCheck = context.stepsAtCheck;
+    return cell;
+}
+
+#define ENGINE_NAME executeTieredBytecode
+#define ENGINE_THREADED HAS_COMPUTED_GOTO
+#define ENGINE_TIERED 1
+#include "engine.h"
+
+#define ENGINE_NAME executeTieredBytecodeUnchecked
+#define ENGINE_THREADED HAS_COMPUTED_GOTO
+#define ENGINE_BOUNDS_CHECKS 0
+#define ENGINE_TIERED 1
+#include "engine.h"
+
+/// @brief Executes a compiled program with the bytecode engine, compiling
+///        each loop to native x86-64 code once it gets hot, so that code
+///        that only runs a few times never has to be compiled.
+/// @param machine the machine to run the program on
+/// @param boundsChecks whether to check for the tape head leaving the tape
+static void runTiered(BFMachine *machine, bool boundsChecks) {
+    const int count = machine->program->count;
+    Tiers tiers = {
+        calloc(count, sizeof(int)),
+        calloc(count, sizeof(JitFunction)),
+        calloc(count, sizeof(size_t)),
+        boundsChecks,
+    };
+    // The compiled loops have to be unmapped even if the run stops short.
+    CATCH_STOP(machine, (boundsChecks ? executeTieredBytecode : executeTieredBytecodeUnchecked)(machine, &tiers));
+    for (int i = 0; i < count; ++i) {
+        if (tiers.loops[i] != NULL) {
+            munmap((void *) tiers.loops[i], tiers.sizes[i]);
+        }
+    }
+    free(tiers.backEdges);
+    free(tiers.loops);
+    free(tiers.sizes);
+}
+
+/// @brief Executes a compiled program with the tiered engine.
+static void executeTiered(BFMachine *machine) {
+    runTiered(machine, true);
+}
+
+/// @brief Executes a compiled program with the tiered engine without any
+///        tape bounds checks, which only works on a virtual tape.
+static void executeTieredUnchecked(BFMachine *machine) {
+    runTiered(machine, false);
+}
+
+#else
+
+/// @brief Executes a compiled program with the bytecode engine, since there
+///        is no JIT for this platform.
+static void executeJIT(BFMachine *machine) {
+    executeBytecode(machine);
+}
+
+/// @brief Executes a compiled program with the bytecode engine without any
+///        tape bounds checks, since there is no JIT for this platform.
+static void executeJITUnchecked(BFMachine *machine) {
+    executeBytecodeUnchecked(machine);
+}
+
+/// @brief Executes a compiled program with the bytecode engine, since there
+///        is no JIT for this platform to compile hot loops with.
+static void executeTiered(BFMachine *machine) {
+    executeBytecode(machine);
+}
+
+/// @brief Executes a compiled program with the bytecode engine without any
+///        tape bounds checks, since there is no JIT for this platform.
+static void executeTieredUnchecked(BFMachine *machine) {
+    executeBytecodeUnchecked(machine);
+}
+
+#endif
+
+/// The execution engines, where the first one is the default.
+const Engine bfEngines[] = {
+#if HAS_COMPUTED_GOTO
+    {"threaded", executeThreaded, executeThreadedUnchecked},
+#endif
+    {"switch", executeSwitch, executeSwitchUnchecked},
+    {"jit", executeJIT, executeJITUnchecked},
+    {"tiered", executeTiered, executeTieredUnchecked},
+};
+
+const int bfEngineCount = sizeof(bfEngines) / sizeof(bfEngines[0]);
+
+/// @brief Finds the execution engine with the given name.
+/// @param name the name of the engine
+/// @return the engine, or NULL if there is no engine with that name
+const Engine *bfFindEngine(const char *name) {
+    for (int i = 0; i < bfEngineCount; ++i) {
+        if (strcmp(bfEngines[i].name, name) == 0) {
+            return &bfEngines[i];
+        }
+    }
+    return NULL;
+}
+
+/// @brief Sets up a machine to run a program with a blank tape and no output yet.
+/// @param program the compiled program
+/// @param input the input stream, or NULL if the program never reads any input
+/// @param virtualTape whether to try to give it a virtual tape, which engines
+///        can run on without any bounds checks
+/// @return the machine
+BFMachine bfNewMachine(Program *program, Input *input, bool virtualTape) {
+    BFMachine machine = {0};
+    machine.program = program;
+    machine.input = input;
+    if (!virtualTape || !bfNewVirtualTape(&machine.tape)) {
+        machine.tape = bfNewTape();
+    }
+    machine.stepLimit = ULLONG_MAX;
+    machine.scan = fastestScan(NULL);
+    return machine;
+}
+
+/// @brief Frees a machine's tape and output buffer, but not its program or input.
+/// @param machine the machine
+void bfFreeMachine(BFMachine *machine) {
+    bfFreeTape(&machine->tape);
+    free(machine->output.buffer);
+    machine->output.buffer = NULL;
+}
+
+#if HAS_VIRTUAL_TAPE
+/// Runs the statement as a run of the machine's program on this thread, so
+/// that the fault handler can find the machine's tape, and stopRun() can
+/// stop it early.
+#define RUN(machine, ...)                                                     \
+    {                                                                         \
+        BFMachine *const outerMachine = runningMachine;                       \
+        runningMachine = (machine);                                           \
+        CATCH_STOP((machine), __VA_ARGS__);                                   \
+        runningMachine = outerMachine;                                        \
+    }
+#else
+#define RUN(machine, ...) CATCH_STOP((machine), __VA_ARGS__)
+#endif
+
+/// @brief Runs a machine's program from start to finish, without any bounds
+///        checks if the machine has a virtual tape.
+/// @param machine the machine
+/// @param engine the execution engine to run it with
+void bfRunMachine(BFMachine *machine, const Engine *engine) {
+    RUN(machine, (machine->tape.isVirtual ? engine->executeUnchecked : engine->execute)(machine));
+}
+
+/// @brief Runs a machine's program from start to finish, counting every
+///        instruction and the tape cells used in the machine's profile.
+/// @param machine the machine, which needs a profile
+void bfRunProfiled(BFMachine *machine) {
+    RUN(machine, executeProfiled(machine));
+}
+
+/// @brief Runs a machine's program from the given instruction until it reaches
+///        a trap, the end of the program, a watched cell changing (if the
+///        machine has watchpoints), or its step limit.
+/// @param machine the machine
+/// @param start the index of the instruction to start at
+/// @param traps the traps patched into the program
+/// @return the index of the instruction it stopped at, which hasn't run yet
+int bfRunUntilTrap(BFMachine *machine, int start, Traps *traps) {
+    const bool watched = machine->watches != NULL && machine->watches->count > 0;
+    machine->stopReason = STOP_END;
+    machine->stoppedAt = start;
+    RUN(machine, machine->stoppedAt = (watched ? executeUntilWatch : executeUntilTrap)(machine, start, traps));
+    return machine->stoppedAt;
+}
+
+/// @brief Runs a machine's program, compiled with an instruction for every
+///        BF character like in the visual mode, from start to finish (or
+///        until its step limit), recording every step in the machine's trace
+///        followed by where it stopped.
+/// @param machine the machine, which needs a trace
+void bfRunTraced(BFMachine *machine) {
+    Traps traps = {0};
+    machine->stopReason = STOP_END;
+    RUN(machine, machine->stoppedAt = executeTraced(machine, 0, &traps));
+    if (machine->stopReason != STOP_END) {
+        // It stopped short partway through a step, so there's nowhere to say it stopped.
+        return;
+    }
+    const Instruction *instruction = &machine->program->instructions[machine->stoppedAt];
+    machine->stopReason = instruction->op == OP_END ? STOP_END : STOP_STEP_LIMIT;
+    recordTraceEvent(machine->trace, TRACE_STOP, instruction->pos, 0, 0);
+}
+
+/// @brief Reads a number written by putTraceLength().
+/// @param file the file to read it from
+/// @param value where to put the number
+/// @return false if the file ended first
+static bool getTraceLength(FILE *file, size_t *value) {
+    unsigned char bytes[4];
+    if (fread(bytes, 1, 4, file) != 4) {
+        return false;
+    }
+    *value = bytes[0] | bytes[1] << 8 | bytes[2] << 16 | (size_t) bytes[3] << 24;
+    return true;
+}
+
+/// @brief Reads the next block of a trace, decompressing it if it was compressed.
+/// @param trace the trace
+/// @return false if there are no more blocks or the block is broken
+static bool readTraceBlock(TraceReader *trace) {
+    size_t length;
+    size_t compressedLength;
+    if (!getTraceLength(trace->file, &length) || !getTraceLength(trace->file, &compressedLength) ||
+        length == 0 || length > TRACE_BLOCK_SIZE || compressedLength > MAX_COMPRESSED_BLOCK_SIZE) {
+        return false;
+    }
+    trace->used = length;
+    trace->index = 0;
+    if (compressedLength == length) {
+        return fread(trace->block, 1, length, trace->file) == length;
+    }
+    return fread(trace->compressed, 1, compressedLength, trace->file) == compressedLength &&
+           decompressBlock(trace->compressed, compressedLength, trace->block, length);
+}
+
+/// @brief Reads the next record of a trace into its record.
+/// @param trace the trace
+/// @return false if the trace ended or is broken
+static bool readTraceRecord(TraceReader *trace) {
+    if (trace->index == trace->used && !readTraceBlock(trace)) {
+        return false;
+    }
+    const unsigned char *block = trace->block;
+    TraceRecord *record = &trace->record;
+    unsigned long long count;
+    unsigned long long posDelta;
+    unsigned long long value = 0;
+    unsigned long long offset = 0;
+    record->kind = block[trace->index++];
+    if (record->kind > TRACE_STOP || !getVarint(block, trace->used, &trace->index, &count) || count == 0 ||
+        !getVarint(block, trace->used, &trace->index, &posDelta)) {
+        return false;
+    }
+    switch (record->kind) {
+        case TRACE_MOVE:
+            if (!getVarint(block, trace->used, &trace->index, &value)) {
+                return false;
+            }
+            value = unzigzag(value);
+            break;
+        case TRACE_WRITE:
+        case TRACE_IN:
+        case TRACE_OUT:
+            if (!getVarint(block, trace->used, &trace->index, &offset) || trace->index == trace->used) {
+                return false;
+            }
+            offset = unzigzag(offset);
+            value = block[trace->index++];
+            break;
+        case TRACE_STEP:
+        case TRACE_STOP:
+            break;
+    }
+    record->count = count;
+    record->posDelta = (int) unzigzag(posDelta);
+    record->offset = (int) offset;
+    record->value = (int) value;
+    return true;
+}
+
+/// @brief Reads the next step of a trace into its next event.
+/// @param trace the trace
+/// @return false if the trace ended without a TRACE_STOP or is broken
+static bool readTraceEvent(TraceReader *trace) {
+    if (trace->record.count == 0 && !readTraceRecord(trace)) {
+        return false;
+    }
+    TraceRecord *record = &trace->record;
+    --record->count;
+    trace->next = (TraceEvent) {record->kind, trace->next.pos + record->posDelta, record->offset, record->value};
+    return true;
+}
+
+/// @brief Opens a trace recorded by bfRunTraced() to replay it from the start.
+/// @param fileName the name of the trace file
+/// @return the trace, or NULL if the file couldn't be read or isn't a trace
+TraceReader *bfOpenTraceReader(const char *fileName) {
+    FILE *file = fopen(fileName, "rb");
+    if (file == NULL) {
+        return NULL;
+    }
+    char magic[sizeof(TRACE_MAGIC) - 1];
+    unsigned char flags;
+    if (fread(magic, 1, sizeof(magic), file) != sizeof(magic) || memcmp(magic, TRACE_MAGIC, sizeof(magic)) != 0 ||
+        fread(&flags, 1, 1, file) != 1) {
+        fclose(file);
+        return NULL;
+    }
+    TraceReader *trace = calloc(1, sizeof(TraceReader));
+    trace->file = file;
+    trace->block = malloc(TRACE_BLOCK_SIZE);
+    trace->compressed = malloc(MAX_COMPRESSED_BLOCK_SIZE);
+    trace->rawOutput = flags & TRACE_RAW_OUTPUT;
+    if (!readTraceEvent(trace)) {
+        bfCloseTraceReader(trace);
+        return NULL;
+    }
+    return trace;
+}
+
+/// @brief Closes a trace that was being replayed.
+/// @param trace the trace
+void bfCloseTraceReader(TraceReader *trace) {
+    fclose(trace->file);
+    free(trace->block);
+    free(trace->compressed);
+    free(trace);
+}
+
+/// @brief Replays the steps of a trace on a machine, changing its tape and
+///        output the way the program did, until it has run the given number
+///        of steps or the trace ends.
+/// @param trace the trace, which has already been replayed up to the
+///        machine's steps
+/// @param machine the machine, whose program isn't used
+/// @param step the step to replay up to
+/// @return the index into the BF code of the instruction the next step
+///         runs (or that the code stopped at), or -1 if the trace is broken
+///         or the machine ran out of tape or memory, which sets its stop reason
+int bfReplayTrace(TraceReader *trace, BFMachine *machine, unsigned long long step) {
+    TraceEvent *event = &trace->next;
+    machine->stopReason = STOP_END;
+    for (; machine->steps < step && event->kind != TRACE_STOP; ++machine->steps) {
+        CellValue *cell = NULL;
+        if (event->kind == TRACE_WRITE || event->kind == TRACE_IN) {
+            cell = bfCellAt(&machine->tape, event->offset);
+            if (cell == NULL) {
+                machine->stopReason = STOP_TAPE;
+                return -1;
+            }
+        }
+        switch (event->kind) {
+            case TRACE_MOVE:
+                machine->tape.head += event->value;
+                break;
+            case TRACE_WRITE:
+                *cell += event->value;
+                break;
+            case TRACE_IN:
+                *cell = event->value;
+                break;
+            case TRACE_OUT:
+                if (!writeValue(&machine->output, event->value)) {
+                    machine->stopReason = STOP_MEMORY;
+                    return -1;
+                }
+                break;
+            case TRACE_STEP:
+            case TRACE_STOP:
+                break;
+        }
+        if (!readTraceEvent(trace)) {
+            return -1;
+        }
+    }
+    return event->pos;
+}
+
+// Printing
+
+/// The length of the visible tape when printed.
+#define TAPE_LENGTH 28
+
+/// @brief Prints where the BF code is in execution, and where the tape header is on the tape.
+/// @param code the BF code
+/// @param codePtr points to the current instruction in the code being executed
+/// @param machine the machine running the code
+/// @param view the part of the tape that was printed last time, which is
+///        moved along if the tape head has left it
+void bfPrintState(const char *code, int codePtr, BFMachine *machine, TapeView *view) {
+    Tape *tape = &machine->tape;
+
+    // The array containing the values that will be
+    CellValue tapeValues[TAPE_LENGTH];
+
+    // Print the results so far, unless they were written out as they came.
+    if (machine->output.write == NULL) {
+        printf("\nResults: ");
+        fwrite(machine->output.buffer, 1, machine->output.index, stdout);
+        putchar('\n');
+    }
+
+    // Say which watchpoint stopped the code, if one did.
+    Watches *watches = machine->watches;
+    if (watches != NULL && watches->hit >= 0) {
+        Watch *watch = &watches->list[watches->hit];
+        printf("Watch: cell %d changed from %d to %d\n",
+               watch->tapeIndex, watches->previous, watches->current);
+    }
+
+    // Print the code
+    printf("Step: %llu\n", machine->steps);
+    printf("Pos: %d\n", codePtr);
+    int i = codePtr < MID_DISTANCE ? 0 : codePtr - MID_DISTANCE;
+    int j = codePtr < MID_DISTANCE ? 2 * MID_DISTANCE : codePtr + MID_DISTANCE;
+    for (; i < j && code[i]; ++i) {
+        putchar(isprint((unsigned char) code[i]) ? code[i] : ' ');
+    }
+    putchar('\n');
+    for (i = 0; i <= (codePtr < MID_DISTANCE ? codePtr : MID_DISTANCE); ++i) {
+        putchar(' ');
+    }
+    printf("^\n");
+
+    // Move the view along if necessary.
+    if (tape->head < view->start) {
+        view->start = tape->head;
+    } else if (tape->head >= view->start + TAPE_LENGTH - 1) {
+        view->start = tape->head - TAPE_LENGTH + 1;
+    }
+
+    // Fill in the tapeValues array with teh values to be printed.
+    const int valuesIndex = tape->head - view->start;
+    for (i = 0; i < TAPE_LENGTH; ++i) {
+        tapeValues[i] = bfPeekCell(tape, view->start + i);
+    }
+  
+    // Print the tape pointer and the tape.
+    for (i = 0; i <= valuesIndex; ++i) {
+        printf("    ");
+    }
+    printf(" v\n... ");
+    for (i = 0; i < TAPE_LENGTH; ++i) {
+        printf("%.03d ", tapeValues[i]);
+    }
+    printf("...\n");
+}
+
+/// @brief Gets the current time in nanoseconds.
+double bfNanoseconds(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec * 1e9 + now.tv_nsec;
+}
+
+/// The total number of cells each benchmark run scans over.
+#define BENCH_SCAN_CELLS (1 << 26)
+
+/// @brief Times the scalar scan against the selected scan function for
+///        several strides and distances to the next 0, and prints the results.
+/// @return EXIT_SUCCESS if both scans always agreed, otherwise EXIT_FAILURE
+int bfBenchScan(void) {
+    const int strides[] = {1, -1, 4, -4, 3};
+    const int distances[] = {4, 16, 64, 256, 1024, 16384};
+    const int strideCount = sizeof(strides) / sizeof(strides[0]);
+    const int distanceCount = sizeof(distances) / sizeof(distances[0]);
+    // Both scans are called through a pointer so neither gets inlined.
+    ScanFunction volatile scalar = scanScalar;
+    const char *scanName;
+    ScanFunction volatile scan = fastestScan(&scanName);
+    bool agreed = true;
+
+    printf("Scan function: %s\n", scanName);
+    printf("%8s %10s %14s %14s %9s\n", "stride", "distance", "scalar ns/op", "selected ns/op", "speedup");
+    for (int i = 0; i < strideCount; ++i) {
+        for (int j = 0; j < distanceCount; ++j) {
+            const int stride = strides[i];
+            const int distance = distances[j];
+            const int length = (distance + 1) * abs(stride) + 64;
+            CellValue *cells = malloc(length);
+            memset(cells, 1, length);
+            const int start = stride > 0 ? 32 : length - 33;
+            const int target = start + distance * stride;
+            cells[target] = 0;
+
+            const int repeats = BENCH_SCAN_CELLS / distance;
+            int scalarResult = 0;
+            int selectedResult = 0;
+            double begin = bfNanoseconds();
+            for (int r = 0; r < repeats; ++r) {
+                scalarResult += scalar(cells, length, start, stride);
+                __asm__ volatile("" ::: "memory");
+            }
+            double scalarTime = (bfNanoseconds() - begin) / repeats;
+            begin = bfNanoseconds();
+            for (int r = 0; r < repeats; ++r) {
+                selectedResult += scan(cells, length, start, stride);
+                __asm__ volatile("" ::: "memory");
+            }
+            double selectedTime = (bfNanoseconds() - begin) / repeats;
+
+            if (scalarResult != selectedResult || scan(cells, length, start, stride) != target) {
+                agreed = false;
+            }
+            printf("%8d %10d %14.1f %14.1f %8.1fx\n",
+                   stride, distance, scalarTime, selectedTime, scalarTime / selectedTime);
+            free(cells);
+        }
+    }
+
+    if (!agreed) {
+        printf("The scan functions disagreed!\n");
+    }
+    return agreed ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+/// The number of cells the tape benchmark's programs walk across and back.
+#define BENCH_TAPE_DISTANCE 4096
+
+/// The number of times each tape benchmark program is run.
+#define BENCH_TAPE_REPEATS 20
+
+/// @brief Times pointer heavy programs on a normal tape with bounds checks
+///        against a virtual tape without them, and prints the results.
+/// @return EXIT_SUCCESS if both tapes always ended up the same, otherwise EXIT_FAILURE
+int bfBenchTape(void) {
+#if HAS_VIRTUAL_TAPE
+    // Each program lays a trail of 2s out to BENCH_TAPE_DISTANCE, then walks
+    // along it and back 255 times with loops like [->] and <[+<], which move
+    // the tape head every third instruction. Their moves can't be folded
+    // into offsets, since the loops don't end up where they started.
+    const char *const names[] = {"walk right", "walk left"};
+    const char directions[][2] = {{'>', '<'}, {'<', '>'}};
+    bool agreed = true;
+
+    printf("%12s %10s %14s %14s %9s\n", "program", "engine", "checked ms", "virtual ms", "speedup");
+    for (int i = 0; i < 2; ++i) {
+        const char out = directions[i][0];
+        const char back = directions[i][1];
+        char *code = malloc(4 * BENCH_TAPE_DISTANCE + 32);
+        char *end = code;
+        // The counter, then a 0 the walks back stop at, then the trail.
+        *end++ = '-';
+        *end++ = out;
+        for (int k = 0; k < BENCH_TAPE_DISTANCE; ++k) {
+            *end++ = out;
+            *end++ = '+';
+            *end++ = '+';
+        }
+        for (int k = 0; k < BENCH_TAPE_DISTANCE + 1; ++k) {
+            *end++ = back;
+        }
+        end += sprintf(end, "[%c%c[-%c]%c[+%c]%c-]", out, out, out, back, back, back);
+        Program program = {0};
+        bfCompile(code, &program, true);
+
+        for (int e = 0; e < bfEngineCount; ++e) {
+            double times[2] = {0, 0};
+            for (int virtual = 0; virtual < 2; ++virtual) {
+                for (int r = 0; r < BENCH_TAPE_REPEATS; ++r) {
+                    double begin = bfNanoseconds();
+                    BFMachine machine = bfNewMachine(&program, NULL, virtual);
+                    bfRunMachine(&machine, &bfEngines[e]);
+                    // Every walk back puts the trail back the way it was.
+                    if (bfPeekCell(&machine.tape, i == 0 ? BENCH_TAPE_DISTANCE + 1 : -BENCH_TAPE_DISTANCE - 1) != 2) {
+                        agreed = false;
+                    }
+                    bfFreeMachine(&machine);
+                    times[virtual] += bfNanoseconds() - begin;
+                }
+            }
+            printf("%12s %10s %14.2f %14.2f %8.2fx\n", names[i], bfEngines[e].name,
+                   times[0] / BENCH_TAPE_REPEATS / 1e6, times[1] / BENCH_TAPE_REPEATS / 1e6, times[0] / times[1]);
+        }
+        free(program.instructions);
+        free(code);
+    }
+
+    if (!agreed) {
+        printf("The tapes disagreed!\n");
+    }
+    return agreed ? EXIT_SUCCESS : EXIT_FAILURE;
+#else
+    printf("Virtual tapes aren't supported on this platform\n");
+    return EXIT_FAILURE;
+#endif
+}
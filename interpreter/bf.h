@@ -0,0 +1,455 @@
+// The BF library the interpreter is built on. Everything a running BF program
+// has lives in its BFMachine instead of in static state, so any number of
+// programs can run at once (one per thread), and other programs (like the
+// transpiler's tests) can run BF code without starting an interpreter.
+//
+// Running code looks like this:
+//   Program program = {0};
+//   bfCompile(code, &program, true);
+//   BFMachine machine = bfNewMachine(&program, bfNewInput(read, context, false), false);
+//   machine.output.write = write;
+//   bfRunMachine(&machine, &bfEngines[0]);
+//   bfFlushOutput(&machine.output);
+//   bfFreeMachine(&machine);
+
+#ifndef BF_H
+#define BF_H
+
+#include <setjmp.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#define HAS_SIMD_SCAN 1
+#else
+#define HAS_SIMD_SCAN 0
+#endif
+
+#if defined(__unix__) || defined(__APPLE__)
+#define HAS_MMAP 1
+#else
+#define HAS_MMAP 0
+#endif
+
+#if HAS_MMAP && defined(__LP64__)
+#define HAS_VIRTUAL_TAPE 1
+#else
+#define HAS_VIRTUAL_TAPE 0
+#endif
+
+#if defined(__x86_64__) && (defined(__linux__) || defined(__APPLE__))
+#define HAS_JIT 1
+#else
+#define HAS_JIT 0
+#endif
+
+/// @brief A tape cell's value is an unsigned 8-bit integer.
+typedef unsigned char CellValue;
+
+/// @brief Defines an infinitely long tape in both directions as
+///        a contiguous block of cells that doubles in size whenever
+///        the tape head walks off of either end.
+typedef struct {
+    CellValue *cells;
+    /// The number of allocated cells.
+    int capacity;
+    /// The position in cells of the initial tape cell.
+    int origin;
+    /// The hypothetical index into the infinitely long tape of the tape head.
+    /// A value of 0 corresponds to the initial tape cell.
+    /// Negative values correspond to tape cells to the left of the initial cell.
+    /// Positive values correspond to tape cells to the right of the initial cell.
+    int head;
+    /// Whether the cells are a virtual tape reserved up front, which never grows.
+    bool isVirtual;
+    /// For a virtual tape, the range of cells that have been committed so far.
+    size_t firstCommitted;
+    size_t endCommitted;
+} Tape;
+
+/// @brief Searches the cells start, start + stride, start + 2 * stride, ...
+///        for the first 0. Cells past either end of the array count as 0.
+/// @param cells the cells to search
+/// @param length the number of cells
+/// @param start the position to start searching from
+/// @param stride the distance between searched cells, negative to search left
+/// @return the position of the first 0, which may be outside of [0, length)
+typedef int (*ScanFunction)(const CellValue *cells, int length, int start, int stride);
+
+/// @brief Writes out a chunk of output.
+/// @param context whatever the output was set up with
+/// @param data the bytes to write
+/// @param length the number of bytes
+typedef void (*WriteFunction)(void *context, const char *data, size_t length);
+
+/// @brief The output stream, which collects the results in a buffer and
+///        writes them out whenever it fills up.
+typedef struct {
+    /// The results of having executed the BF code that haven't been written out yet.
+    char *buffer;
+    /// How much of the buffer has been used up.
+    size_t index;
+    /// The number of bytes allocated for the buffer.
+    size_t capacity;
+    /// Where the buffer is written to whenever it fills up, or NULL to keep
+    /// all of the output in the buffer (for the visual mode).
+    WriteFunction write;
+    void *context;
+    /// Whether each output value is written as a single byte instead of in decimal.
+    bool raw;
+} Output;
+
+/// @brief Reads in a chunk of input.
+/// @param context whatever the input was set up with
+/// @param buffer where to put the bytes
+/// @param size the most bytes to read
+/// @return the number of bytes read, which is 0 once the input runs out
+typedef size_t (*ReadFunction)(void *context, unsigned char *buffer, size_t size);
+
+/// The size of the buffer the input stream is read into.
+#define INPUT_BUFFER_SIZE (1 << 16)
+
+/// @brief The input stream, read a buffer at a time so the whole input never
+///        has to be in memory.
+typedef struct {
+    ReadFunction read;
+    void *context;
+    unsigned char buffer[INPUT_BUFFER_SIZE];
+    /// The index of the next unread byte in the buffer.
+    size_t index;
+    /// The number of bytes in the buffer.
+    size_t count;
+    /// Whether each ',' reads a single byte instead of a decimal number.
+    bool raw;
+} Input;
+
+/// @brief The whole contents of a file followed by a '\0', so that it can be
+///        read like a string no matter how big it is.
+typedef struct {
+    char *data;
+    size_t size;
+    /// The number of bytes mapped into memory, or 0 if data was allocated instead.
+    size_t mappedSize;
+} FileContents;
+
+/// @brief The operations of the compiled bytecode.
+typedef enum {
+    OP_ADD,     ///< Adds arg to the cell at offset.
+    OP_MOVE,    ///< Moves the tape head by arg cells.
+    OP_OUT,     ///< Outputs the cell at offset.
+    OP_IN,      ///< Reads the next input value into the cell at offset.
+    OP_JZ,      ///< Jumps to instruction arg if the current cell is zero.
+    OP_JNZ,     ///< Jumps to instruction arg if the current cell is not zero.
+    OP_SET,     ///< Sets the cell at offset to arg, like [-] or [-]+++.
+    OP_MUL,     ///< Adds the current cell times arg to the cell at offset, like [->++<].
+    OP_PRODUCT, ///< Adds the current cell times another cell (see PRODUCT_ARG) to the cell at offset.
+    OP_SCAN,    ///< Moves the tape head by arg cells until it finds a 0, like [>].
+    OP_TRAP,    ///< Stops execution in the visual mode, in place of another operation.
+    OP_END,     ///< Stops execution.
+    // Superinstructions, which bfCompile() puts in place of the first of two
+    // instructions that often run one after the other, and which run both
+    // at once. The second instruction stays as it was, for jumps to it.
+    OP_ADD_ADD,
+    OP_ADD_MOVE,
+    OP_ADD_OUT,
+    OP_OUT_ADD,
+    OP_SET_MOVE,
+    OP_MUL_SET,
+    OP_MOVE_JZ,
+    OP_MOVE_JNZ
+} OpCode;
+
+/// The names of the operations, for printing.
+extern const char *const bfOpNames[];
+
+/// @brief A superinstruction and the two operations it runs.
+typedef struct {
+    OpCode op;
+    OpCode first;
+    OpCode second;
+} Superinstruction;
+
+/// The superinstructions, picked from the output of --dump-ngrams.
+extern const Superinstruction bfSuperinstructions[];
+
+/// The number of superinstructions.
+extern const int bfSuperinstructionCount;
+
+/// @brief Packs the offset of the cell an OP_PRODUCT multiplies the current
+///        cell by, and the constant it multiplies both by, into its arg.
+#define PRODUCT_ARG(source, factor) ((source) * 256 + (CellValue) (factor))
+/// The offset of the other cell an OP_PRODUCT with the given arg multiplies.
+#define PRODUCT_SOURCE(arg) (((arg) - PRODUCT_FACTOR(arg)) / 256)
+/// The constant an OP_PRODUCT with the given arg multiplies by.
+#define PRODUCT_FACTOR(arg) ((CellValue) (arg))
+
+/// @brief A single bytecode instruction.
+typedef struct {
+    OpCode op;
+    int arg;
+    /// The tape offset from the tape head of the cell the instruction works
+    /// on. Optimized programs fold the moves in a straight run into the
+    /// offsets, only moving the tape head where it has to really be there.
+    int offset;
+    /// The index into the BF code of the first character of the instruction.
+    int pos;
+    /// For OP_JZ, OP_JNZ, OP_END, OP_OUT and OP_IN in optimized programs, the
+    /// number of instructions run since the last of them, which the engines
+    /// take off the steps they have left whenever they get to it. It counts
+    /// a jump itself, but not OP_END or I/O, which haven't run yet when they
+    /// stop the engine. It is 0 everywhere else.
+    int steps;
+} Instruction;
+
+/// @brief BF code compiled into bytecode.
+typedef struct {
+    Instruction *instructions;
+    int count;
+    int capacity;
+    /// The farthest from the tape head any instruction works on a cell.
+    int reach;
+} Program;
+
+/// @brief The traps patched into a program for the visual mode, along with
+///        the operations they replaced.
+typedef struct {
+    /// The operation each instruction had before a trap replaced it.
+    OpCode *savedOps;
+    /// The indices of the instructions that are traps right now.
+    int *indices;
+    int count;
+    int capacity;
+} Traps;
+
+/// @brief A tape cell that stops the visual mode when it changes.
+typedef struct {
+    /// The index of the cell on the tape.
+    int tapeIndex;
+    /// The value the cell has to change to, or -1 for any change.
+    int value;
+} Watch;
+
+/// @brief The watchpoints set in the visual mode, along with the last one hit.
+typedef struct {
+    Watch *list;
+    int count;
+    int capacity;
+    /// The index of the watch that stopped the engine, or -1 if none did.
+    int hit;
+    /// The value the watched cell had before it changed.
+    CellValue previous;
+    /// The value the watched cell changed to.
+    CellValue current;
+} Watches;
+
+/// @brief What the profiling engine counts while it runs.
+typedef struct {
+    /// The number of times each instruction was executed.
+    unsigned long long *counts;
+    /// The lowest tape index that was used.
+    int lowestTapeIndex;
+    /// The highest tape index that was used.
+    int highestTapeIndex;
+} Profile;
+
+/// @brief What a step recorded in a trace did.
+typedef enum {
+    TRACE_STEP,     ///< Nothing but move on in the code, like a jump.
+    TRACE_MOVE,     ///< Moved the tape head by value cells.
+    TRACE_WRITE,    ///< Added value to the cell at offset.
+    TRACE_IN,       ///< Read value from the input into the cell at offset.
+    TRACE_OUT,      ///< Output value, from the cell at offset.
+    TRACE_STOP      ///< Not a step, but where the code stopped, at the end of every trace.
+} TraceKind;
+
+/// @brief A single step of a trace.
+typedef struct {
+    TraceKind kind;
+    /// The index into the BF code of the instruction the step ran.
+    int pos;
+    /// The offset from the tape head of the cell the step used.
+    int offset;
+    int value;
+} TraceEvent;
+
+/// @brief Steps in a row that each did the same thing, which is how a trace
+///        stores them.
+typedef struct {
+    TraceKind kind;
+    /// How far each step is along the BF code from the step before it.
+    int posDelta;
+    int offset;
+    int value;
+    /// The number of steps, which is 0 for no record at all.
+    unsigned long long count;
+} TraceRecord;
+
+/// The most bytes of records a trace compresses at a time.
+#define TRACE_BLOCK_SIZE (1 << 16)
+
+/// @brief A trace being recorded to a file. The records are collected in a
+///        block that is compressed and written out whenever it fills up.
+typedef struct {
+    FILE *file;
+    /// The records of the block being filled in.
+    unsigned char *block;
+    size_t used;
+    /// Where the compressed block goes before it is written out.
+    unsigned char *compressed;
+    /// The last steps recorded, which are only put in the block once a
+    /// step does something else.
+    TraceRecord pending;
+    /// The position in the BF code of the last step.
+    int pos;
+    /// Whether any write to the file failed.
+    bool failed;
+} TraceWriter;
+
+/// @brief A trace being read back from a file, a block at a time.
+typedef struct {
+    FILE *file;
+    /// The records of the block being read.
+    unsigned char *block;
+    size_t used;
+    /// The index of the next unread byte in the block.
+    size_t index;
+    /// Where each compressed block is read into.
+    unsigned char *compressed;
+    /// The steps of the record being read that haven't been read yet.
+    TraceRecord record;
+    /// The next step to replay, or where the code stopped.
+    TraceEvent next;
+    /// Whether the output was written as bytes instead of in decimal.
+    bool rawOutput;
+} TraceReader;
+
+/// @brief Why a machine's engine stopped running.
+typedef enum {
+    STOP_END,           ///< It ran to the end of the program.
+    STOP_STEP_LIMIT,    ///< It ran more steps than its step limit.
+    STOP_DEADLINE,      ///< It ran past its deadline.
+    STOP_TAPE,          ///< The tape head ran off the end of a tape that can't grow any more.
+    STOP_MEMORY         ///< There wasn't enough memory left for the output.
+} StopReason;
+
+/// @brief Everything a BF program needs to run, so that machines never share
+///        anything but their (read only) programs.
+typedef struct {
+    /// The compiled program, which any number of machines can run at once as
+    /// long as none of them patches traps into it.
+    Program *program;
+    Tape tape;
+    /// The input stream, or NULL if the program never reads any input.
+    Input *input;
+    Output output;
+    /// The number of instructions run so far.
+    unsigned long long steps;
+    /// The number of steps the engines stop at. The engines with traps stop
+    /// right before the step that would go past it, while the others only
+    /// check it at loop back edges and I/O, so they stop soon after it.
+    unsigned long long stepLimit;
+    /// The time from bfNanoseconds() the engines without traps stop at, or 0
+    /// to never stop. It is only checked every so many steps.
+    double deadline;
+    /// Why the engine stopped.
+    StopReason stopReason;
+    /// The index of the instruction the engine stopped at, if it stopped at
+    /// one of the machine's limits.
+    int stoppedAt;
+    /// Where a run goes back to when it runs out of tape or memory partway
+    /// through an instruction, which leaves the steps it ran since it last
+    /// checked its limits uncounted.
+    jmp_buf escape;
+    /// Where the profiling engine counts what it runs, or NULL.
+    Profile *profile;
+    /// The watchpoints the engine with watch hooks stops at, or NULL.
+    Watches *watches;
+    /// Where the tracing engine records every step it runs, or NULL.
+    TraceWriter *trace;
+    /// The scan function OP_SCAN runs, the fastest one the CPU supports.
+    ScanFunction scan;
+} BFMachine;
+
+/// @brief An execution engine that can be picked from the cmd line.
+typedef struct {
+    const char *name;
+    void (*execute)(BFMachine *machine);
+    /// The same engine without any tape bounds checks, which can only run on
+    /// a virtual tape.
+    void (*executeUnchecked)(BFMachine *machine);
+} Engine;
+
+/// The execution engines, where the first one is the default.
+extern const Engine bfEngines[];
+
+/// The number of execution engines.
+extern const int bfEngineCount;
+
+// Tapes
+Tape bfNewTape(void);
+bool bfNewVirtualTape(Tape *tape);
+void bfFreeTape(Tape *tape);
+void bfUsedTapeIndices(Tape *tape, int *first, int *end);
+CellValue *bfCellAt(Tape *tape, int offset);
+CellValue bfPeekCell(Tape *tape, int tapeIndex);
+
+// Input and output
+void bfWriteToFile(void *file, const char *data, size_t length);
+void bfFlushOutput(Output *output);
+Input *bfNewInput(ReadFunction read, void *context, bool raw);
+Input *bfOpenInput(const char *fileName, bool raw);
+long bfInputPosition(Input *input);
+bool bfSeekInput(Input *input, long position);
+bool bfRewindInput(Input *input);
+void bfCloseInput(Input *input);
+bool bfLoadFile(const char *fileName, FileContents *contents);
+void bfUnloadFile(FileContents *contents);
+
+// Compiling
+int *bfMatchBrackets(const char *code);
+bool bfCompile(const char *code, Program *program, bool optimize);
+OpCode bfBaseOp(OpCode op);
+void bfSetTrap(Program *program, Traps *traps, int index);
+void bfClearTraps(Program *program, Traps *traps);
+OpCode bfOriginalOp(Program *program, Traps *traps, int index);
+bool bfAddWatch(Watches *watches, const char *description);
+
+// Running
+BFMachine bfNewMachine(Program *program, Input *input, bool virtualTape);
+void bfFreeMachine(BFMachine *machine);
+void bfRunMachine(BFMachine *machine, const Engine *engine);
+bool bfProcess(const char *code, int *jumps, int *codeIndex, BFMachine *machine);
+void bfRunProfiled(BFMachine *machine);
+int bfRunUntilTrap(BFMachine *machine, int start, Traps *traps);
+void bfRunTraced(BFMachine *machine);
+const Engine *bfFindEngine(const char *name);
+
+// Traces
+TraceWriter *bfOpenTraceWriter(const char *fileName, bool rawOutput);
+bool bfCloseTraceWriter(TraceWriter *trace);
+TraceReader *bfOpenTraceReader(const char *fileName);
+void bfCloseTraceReader(TraceReader *trace);
+int bfReplayTrace(TraceReader *trace, BFMachine *machine, unsigned long long step);
+
+// Printing
+
+/// The distance to the middle of the stream of printed BF code.
+#define MID_DISTANCE 60
+
+/// @brief The part of the tape bfPrintState() shows, which only moves once the
+///        tape head leaves it, so that the cells don't jump around between
+///        one print and the next. Whoever prints keeps it, starting at {0}.
+typedef struct {
+    /// The tape index of the first cell shown.
+    int start;
+} TapeView;
+
+void bfPrintState(const char *code, int codePtr, BFMachine *machine, TapeView *view);
+
+// Benchmarks
+double bfNanoseconds(void);
+int bfBenchScan(void);
+int bfBenchTape(void);
+
+#endif
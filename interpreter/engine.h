@@ -0,0 +1,580 @@
+// The body of a bytecode execution engine.
+//
+// bf.c includes this file once for every engine it needs after defining:
+//   ENGINE_NAME      the name of the function to define
+//   ENGINE_THREADED  1 to dispatch with computed gotos (direct threading),
+//                    0 to dispatch with a switch statement in a loop
+// and optionally:
+//   ENGINE_PROFILE   1 to count every instruction and the tape cells used
+//                    in the machine's profile, 0 (the default) not to
+//   ENGINE_BOUNDS_CHECKS  1 (the default) to grow the tape whenever the tape
+//                    head leaves it, 0 to never check, for virtual tapes
+//   ENGINE_TRAPS     1 to stop at OP_TRAP instructions, 0 (the default) for
+//                    engines that never see them. An engine with traps
+//                    starts at a given instruction and returns the index of
+//                    the instruction it stopped at. An engine without traps
+//                    counts its steps a straight run at a time, and only
+//                    checks the machine's step limit and deadline at loop
+//                    back edges and I/O.
+//   ENGINE_WATCH     1 to also stop right after an instruction changes a cell
+//                    with a watchpoint on it, 0 (the default) not to. Only
+//                    the instructions that write to the tape check, and only
+//                    engines with traps can have watch hooks.
+//   ENGINE_STEPS     1 to count every instruction run in the machine's steps
+//                    and stop before the one that would go past its
+//                    stepLimit, 0 (the default) not to. Only engines with
+//                    traps can count steps.
+//   ENGINE_TRACE     1 to record what every instruction does in the
+//                    machine's trace, 0 (the default) not to. Only engines
+//                    that count steps can trace, so that every step of the
+//                    trace is one the visual mode can stop at.
+//   ENGINE_TIERED    1 to count how often every loop jumps back to its start
+//                    and run the loops that get hot as JIT compiled code
+//                    from then on, 0 (the default) not to. A tiered engine
+//                    takes the Tiers it keeps the counts and code in. Only
+//                    engines without traps can be tiered.
+//
+// Both kinds of dispatch share the same instruction bodies below, so the
+// engines can only differ in how they get from one instruction to the next.
+// The superinstructions run their two instructions' bodies back to back,
+// except in the engines that stop at or count every instruction, which run
+// them one instruction at a time.
+// The profiling, watch and trace hooks compile down to nothing in engines that
+// don't use them.
+
+#ifndef ENGINE_PROFILE
+#define ENGINE_PROFILE 0
+#endif
+#ifndef ENGINE_BOUNDS_CHECKS
+#define ENGINE_BOUNDS_CHECKS 1
+#endif
+#ifndef ENGINE_TRAPS
+#define ENGINE_TRAPS 0
+#endif
+#ifndef ENGINE_WATCH
+#define ENGINE_WATCH 0
+#endif
+#ifndef ENGINE_STEPS
+#define ENGINE_STEPS 0
+#endif
+#ifndef ENGINE_TRACE
+#define ENGINE_TRACE 0
+#endif
+#ifndef ENGINE_TIERED
+#define ENGINE_TIERED 0
+#endif
+#if ENGINE_WATCH && !ENGINE_TRAPS
+#error "Only engines with traps can have watch hooks"
+#endif
+#if ENGINE_STEPS && !ENGINE_TRAPS
+#error "Only engines with traps can count steps"
+#endif
+#if ENGINE_TRACE && !ENGINE_STEPS
+#error "Only engines that count steps can trace"
+#endif
+#if ENGINE_TIERED && ENGINE_TRAPS
+#error "Only engines without traps can be tiered"
+#endif
+
+#if ENGINE_PROFILE
+/// Counts the instruction ip points to.
+#define PROFILE_INSTRUCTION ++machine->profile->counts[ip - program->instructions]
+/// Records that the tape cell at the given index was used.
+#define PROFILE_TAPE(tapeIndex)                                               \
+    if ((tapeIndex) < machine->profile->lowestTapeIndex) {                    \
+        machine->profile->lowestTapeIndex = (tapeIndex);                      \
+    } else if ((tapeIndex) > machine->profile->highestTapeIndex) {            \
+        machine->profile->highestTapeIndex = (tapeIndex);                     \
+    }
+#else
+#define PROFILE_INSTRUCTION
+#define PROFILE_TAPE(tapeIndex)
+#endif
+
+#if ENGINE_WATCH
+/// Remembers the value of a cell before the instruction writes to it.
+#define WATCH_BEFORE(target) const CellValue watchedValue = *(target)
+/// Stops after the instruction if its write to the cell at the given tape
+/// index set off a watchpoint.
+#define WATCH_AFTER(tapeIndex, target)                                        \
+    if (watchTriggered(machine->watches, (tapeIndex), watchedValue, *(target))) { \
+        STOP(ip + 1 - program->instructions);                                 \
+    }
+#else
+#define WATCH_BEFORE(target)
+#define WATCH_AFTER(tapeIndex, target)
+#endif
+
+#if ENGINE_TRACE
+/// Records a step of the instruction ip points to in the machine's trace.
+#define TRACE(kind, offset, value) recordTraceEvent(machine->trace, (kind), ip->pos, (offset), (value))
+#else
+#define TRACE(kind, offset, value)
+#endif
+
+#if ENGINE_STEPS
+// The steps left are counted down in a local, since the machine's count would
+// have to be reloaded after every write to a cell, and only saved when stopping.
+/// Stops before the instruction ip points to if the step limit has been
+/// reached, and otherwise counts it as a step.
+#define COUNT_STEP                                                            \
+    if (stepsLeft == 0) {                                                     \
+        STOP(ip - program->instructions);                                     \
+    }                                                                         \
+    --stepsLeft
+/// Takes back the step counted for an instruction that stops the engine instead of running.
+#define UNCOUNT_STEP ++stepsLeft
+/// Saves the steps run so far in the machine.
+#define SAVE_STEPS machine->steps = machine->stepLimit - stepsLeft
+#else
+#define COUNT_STEP
+#define UNCOUNT_STEP
+#define SAVE_STEPS
+#endif
+
+#if ENGINE_BOUNDS_CHECKS
+/// Grows the tape until every cell the program reaches from the tape head is
+/// on it, and works out how far the tape head can move before it has to
+/// grow the tape again, so that only moves ever check the tape bounds.
+#define REACH_CELLS                                                           \
+    cell = reachCells(machine, program->reach);                               \
+    low = tape->cells + program->reach;                                       \
+    high = tape->cells + tape->capacity - program->reach
+#else
+#define REACH_CELLS
+#endif
+
+#if ENGINE_TRAPS
+#define COUNT_RUN
+#define CHECK_LIMITS
+#else
+/// Counts the steps of the straight run of instructions that ends at the
+/// jump, I/O (or the end) ip points to.
+#define COUNT_RUN stepsLeft -= ip->steps
+/// Stops the engine at the instruction ip points to once it has run all of
+/// the steps it could before checking the machine's limits, unless they say
+/// it can keep going.
+#define CHECK_LIMITS                                                          \
+    if (stepsLeft < 0 && !withinLimits(machine, &stepsLeft, &stepsAtCheck)) { \
+        machine->stoppedAt = ip - program->instructions;                      \
+        return;                                                               \
+    }
+#endif
+
+#if ENGINE_TIERED
+/// Counts a jump back to the start of the body of a loop, given by the index
+/// of its first instruction, and compiles the loop once it is hot.
+#define COUNT_BACK_EDGE(body)                                                 \
+    if (++tiers->backEdges[(body)] == HOT_LOOP_BACK_EDGES) {                  \
+        compileHotLoop(tiers, program, (body));                               \
+    }
+/// Runs the rest of the loop whose body starts at the given instruction as
+/// compiled code if the loop is hot, and goes on after the loop.
+#define RUN_HOT_LOOP(body)                                                    \
+    if (tiers->loops[(body)] != NULL) {                                       \
+        cell = runHotLoop(tiers, machine, (body), cell, &stepsLeft, &stepsAtCheck); \
+        if (machine->stopReason != STOP_END) {                                \
+            return;                                                           \
+        }                                                                     \
+        REACH_CELLS;                                                          \
+        JUMP(program->instructions[(body) - 1].arg);                          \
+    }
+#else
+#define COUNT_BACK_EDGE(body)
+#define RUN_HOT_LOOP(body)
+#endif
+
+/// Stops an engine with traps, returning the index of the next instruction to run.
+#define STOP(index)                                                           \
+    {                                                                         \
+        SAVE_STEPS;                                                           \
+        return (index);                                                       \
+    }
+
+#if ENGINE_THREADED
+/// Jumps straight to the code for the instruction ip points to.
+#define DISPATCH                                                              \
+    COUNT_STEP;                                                               \
+    PROFILE_INSTRUCTION;                                                      \
+    goto *labels[ip->op]
+/// Runs the code for the given operation on the instruction ip points to.
+#define DISPATCH_OP(opCode) goto *labels[(opCode)]
+/// Starts the code for an operation.
+#define CASE(name) label_##name:
+#else
+/// Goes back to the switch statement to find the code for the instruction ip points to.
+#define DISPATCH continue
+/// Runs the code for the given operation on the instruction ip points to.
+#define DISPATCH_OP(opCode)                                                   \
+    op = (opCode);                                                            \
+    goto dispatchOp
+/// Starts the code for an operation.
+#define CASE(name) case name:
+#endif
+
+/// Moves on to the next instruction.
+#define NEXT                                                                  \
+    ++ip;                                                                     \
+    DISPATCH
+
+/// Moves on to the instruction at the given index.
+#define JUMP(target)                                                          \
+    ip = &program->instructions[(target)];                                    \
+    DISPATCH
+
+#if ENGINE_TRAPS || ENGINE_PROFILE
+/// Moves on from the first instruction of a superinstruction to the second,
+/// which engines that stop at or count every instruction run on its own.
+#define THEN NEXT
+#else
+/// Moves on from the first instruction of a superinstruction to the second,
+/// without going through the dispatch in between.
+#define THEN ++ip
+#endif
+
+// The code of the operations, on the instruction ip points to, which the
+// superinstructions run one after the other.
+
+/// Runs OP_ADD.
+#define ADD_CODE                                                              \
+    {                                                                         \
+        CellValue *target = cell + ip->offset;                                \
+        WATCH_BEFORE(target);                                                 \
+        *target += ip->arg;                                                   \
+        TRACE(TRACE_WRITE, ip->offset, ip->arg);                              \
+        PROFILE_TAPE(tape->head + ip->offset);                                \
+        WATCH_AFTER(tape->head + ip->offset, target);                         \
+    }
+
+#if ENGINE_BOUNDS_CHECKS
+/// Runs OP_MOVE.
+#define MOVE_CODE                                                             \
+    tape->head += ip->arg;                                                    \
+    cell += ip->arg;                                                          \
+    if (cell < low || cell >= high) {                                         \
+        REACH_CELLS;                                                          \
+    }                                                                         \
+    TRACE(TRACE_MOVE, 0, ip->arg);                                            \
+    PROFILE_TAPE(tape->head)
+#else
+#define MOVE_CODE                                                             \
+    tape->head += ip->arg;                                                    \
+    cell += ip->arg;                                                          \
+    TRACE(TRACE_MOVE, 0, ip->arg);                                            \
+    PROFILE_TAPE(tape->head)
+#endif
+
+/// Runs OP_OUT.
+#define OUT_CODE                                                              \
+    COUNT_RUN;                                                                \
+    CHECK_LIMITS;                                                             \
+    outputValue(machine, cell[ip->offset]);                                   \
+    TRACE(TRACE_OUT, ip->offset, cell[ip->offset]);                           \
+    PROFILE_TAPE(tape->head + ip->offset)
+
+/// Runs OP_JZ, jumping away if the current cell is zero.
+#define JZ_CODE                                                               \
+    COUNT_RUN;                                                                \
+    TRACE(TRACE_STEP, 0, 0);                                                  \
+    if (*cell == 0) {                                                         \
+        JUMP(ip->arg);                                                        \
+    }                                                                         \
+    RUN_HOT_LOOP(ip + 1 - program->instructions)
+
+/// Runs OP_JNZ, jumping away if the current cell is not zero.
+#define JNZ_CODE                                                              \
+    COUNT_RUN;                                                                \
+    TRACE(TRACE_STEP, 0, 0);                                                  \
+    if (*cell != 0) {                                                         \
+        CHECK_LIMITS;                                                         \
+        COUNT_BACK_EDGE(ip->arg);                                             \
+        RUN_HOT_LOOP(ip->arg);                                                \
+        JUMP(ip->arg);                                                        \
+    }
+
+/// Runs OP_SET.
+#define SET_CODE                                                              \
+    {                                                                         \
+        CellValue *target = cell + ip->offset;                                \
+        WATCH_BEFORE(target);                                                 \
+        TRACE(TRACE_WRITE, ip->offset, (CellValue) (ip->arg - *target));      \
+        *target = ip->arg;                                                    \
+        PROFILE_TAPE(tape->head + ip->offset);                                \
+        WATCH_AFTER(tape->head + ip->offset, target);                         \
+    }
+
+/// Runs OP_MUL.
+#define MUL_CODE                                                              \
+    TRACE(TRACE_WRITE, ip->offset, (CellValue) (*cell * ip->arg));            \
+    if (*cell != 0) {                                                         \
+        CellValue *target = cell + ip->offset;                                \
+        WATCH_BEFORE(target);                                                 \
+        *target += *cell * ip->arg;                                           \
+        PROFILE_TAPE(tape->head + ip->offset);                                \
+        WATCH_AFTER(tape->head + ip->offset, target);                         \
+    }
+
+#if ENGINE_TRAPS
+/// @brief Executes a compiled program from the given instruction until it
+///        reaches a trap or the end of the program (or changes a watched
+///        cell in engines with watch hooks, or reaches the step limit in
+///        engines that count steps). A trap on the first instruction
+///        is skipped by running the operation it replaced.
+/// @param machine the machine to run the program on
+/// @param start the index of the instruction to start at
+/// @param traps the traps patched into the program
+/// @return the index of the instruction it stopped at, which hasn't run yet
+static int ENGINE_NAME(BFMachine *machine, int start, Traps *traps) {
+    Program *program = machine->program;
+    Instruction *ip = &program->instructions[start];
+    Instruction *resume = ip;
+#if ENGINE_STEPS
+    unsigned long long stepsLeft = machine->stepLimit - machine->steps;
+#endif
+#else
+#if ENGINE_TIERED
+/// @brief Executes a compiled program from start to finish, running the
+///        loops that get hot as JIT compiled code.
+/// @param machine the machine to run the program on
+/// @param tiers the back edge counts and compiled code of the loops
+static void ENGINE_NAME(BFMachine *machine, Tiers *tiers) {
+    machine->stopReason = STOP_END;
+#else
+/// @brief Executes a compiled program from start to finish.
+/// @param machine the machine to run the program on
+static void ENGINE_NAME(BFMachine *machine) {
+#endif
+    Program *program = machine->program;
+    Instruction *ip = program->instructions;
+    long long stepsLeft = stepsUntilCheck(machine);
+    long long stepsAtCheck = stepsLeft;
+#endif
+    Tape *tape = &machine->tape;
+    Input *input = machine->input;
+    const ScanFunction scan = machine->scan;
+    CellValue *cell = reachCells(machine, 0);
+#if ENGINE_BOUNDS_CHECKS
+    // The cells the tape head can be on without any instruction reaching off the tape.
+    CellValue *low;
+    CellValue *high;
+    REACH_CELLS;
+#endif
+
+#if ENGINE_THREADED
+    static void *const labels[] = {
+        [OP_ADD] = &&label_OP_ADD,
+        [OP_MOVE] = &&label_OP_MOVE,
+        [OP_OUT] = &&label_OP_OUT,
+        [OP_IN] = &&label_OP_IN,
+        [OP_JZ] = &&label_OP_JZ,
+        [OP_JNZ] = &&label_OP_JNZ,
+        [OP_SET] = &&label_OP_SET,
+        [OP_MUL] = &&label_OP_MUL,
+        [OP_PRODUCT] = &&label_OP_PRODUCT,
+        [OP_SCAN] = &&label_OP_SCAN,
+        [OP_TRAP] = &&label_OP_TRAP,
+        [OP_END] = &&label_OP_END,
+        [OP_ADD_ADD] = &&label_OP_ADD_ADD,
+        [OP_ADD_MOVE] = &&label_OP_ADD_MOVE,
+        [OP_ADD_OUT] = &&label_OP_ADD_OUT,
+        [OP_OUT_ADD] = &&label_OP_OUT_ADD,
+        [OP_SET_MOVE] = &&label_OP_SET_MOVE,
+        [OP_MUL_SET] = &&label_OP_MUL_SET,
+        [OP_MOVE_JZ] = &&label_OP_MOVE_JZ,
+        [OP_MOVE_JNZ] = &&label_OP_MOVE_JNZ,
+    };
+    DISPATCH;
+    {
+#else
+    for (;;) {
+        COUNT_STEP;
+        PROFILE_INSTRUCTION;
+#if ENGINE_TRAPS
+        OpCode op = ip->op;
+    dispatchOp:
+        switch (op) {
+#else
+        switch (ip->op) {
+#endif
+#endif
+            CASE(OP_ADD) {
+                ADD_CODE;
+                NEXT;
+            }
+            CASE(OP_MOVE) {
+                MOVE_CODE;
+                NEXT;
+            }
+            CASE(OP_OUT) {
+                OUT_CODE;
+                NEXT;
+            }
+            CASE(OP_IN) {
+                COUNT_RUN;
+                CHECK_LIMITS;
+                CellValue *target = cell + ip->offset;
+                WATCH_BEFORE(target);
+                *target = readValue(input);
+                TRACE(TRACE_IN, ip->offset, *target);
+                PROFILE_TAPE(tape->head + ip->offset);
+                WATCH_AFTER(tape->head + ip->offset, target);
+                NEXT;
+            }
+            CASE(OP_JZ) {
+                JZ_CODE;
+                NEXT;
+            }
+            CASE(OP_JNZ) {
+                JNZ_CODE;
+                NEXT;
+            }
+            CASE(OP_SET) {
+                SET_CODE;
+                NEXT;
+            }
+            CASE(OP_MUL) {
+                MUL_CODE;
+                NEXT;
+            }
+            CASE(OP_PRODUCT) {
+                TRACE(TRACE_WRITE, ip->offset,
+                      (CellValue) (*cell * cell[PRODUCT_SOURCE(ip->arg)] * PRODUCT_FACTOR(ip->arg)));
+                if (*cell != 0) {
+                    const int source = PRODUCT_SOURCE(ip->arg);
+                    CellValue *target = cell + ip->offset;
+                    WATCH_BEFORE(target);
+                    *target += *cell * cell[source] * PRODUCT_FACTOR(ip->arg);
+                    PROFILE_TAPE(tape->head + source);
+                    PROFILE_TAPE(tape->head + ip->offset);
+                    WATCH_AFTER(tape->head + ip->offset, target);
+                }
+                NEXT;
+            }
+            CASE(OP_SCAN) {
+                if (*cell != 0) {
+                    int position = scan(tape->cells, tape->capacity, cell - tape->cells, ip->arg);
+                    TRACE(TRACE_MOVE, 0, position - tape->origin - tape->head);
+                    tape->head = position - tape->origin;
+                    cell = reachCells(machine, 0);
+                    REACH_CELLS;
+                    PROFILE_TAPE(tape->head);
+                } else {
+                    TRACE(TRACE_STEP, 0, 0);
+                }
+                NEXT;
+            }
+            CASE(OP_ADD_ADD) {
+                ADD_CODE;
+                THEN;
+                ADD_CODE;
+                NEXT;
+            }
+            CASE(OP_ADD_MOVE) {
+                ADD_CODE;
+                THEN;
+                MOVE_CODE;
+                NEXT;
+            }
+            CASE(OP_ADD_OUT) {
+                ADD_CODE;
+                THEN;
+                OUT_CODE;
+                NEXT;
+            }
+            CASE(OP_OUT_ADD) {
+                OUT_CODE;
+                THEN;
+                ADD_CODE;
+                NEXT;
+            }
+            CASE(OP_SET_MOVE) {
+                SET_CODE;
+                THEN;
+                MOVE_CODE;
+                NEXT;
+            }
+            CASE(OP_MUL_SET) {
+                MUL_CODE;
+                THEN;
+                SET_CODE;
+                NEXT;
+            }
+            CASE(OP_MOVE_JZ) {
+                MOVE_CODE;
+                THEN;
+                JZ_CODE;
+                NEXT;
+            }
+            CASE(OP_MOVE_JNZ) {
+                MOVE_CODE;
+                THEN;
+                JNZ_CODE;
+                NEXT;
+            }
+#if ENGINE_TRAPS
+            CASE(OP_TRAP) {
+                if (ip == resume) {
+                    resume = NULL;
+                    DISPATCH_OP(traps->savedOps[ip - program->instructions]);
+                }
+                UNCOUNT_STEP;
+                STOP(ip - program->instructions);
+            }
+            CASE(OP_END) {
+                UNCOUNT_STEP;
+                STOP(ip - program->instructions);
+            }
+#else
+            // Only the engines with traps ever see a trap.
+            CASE(OP_TRAP)
+            CASE(OP_END) {
+                COUNT_RUN;
+                machine->steps += stepsAtCheck - stepsLeft;
+                machine->stopReason = STOP_END;
+                return;
+            }
+#endif
+#if ENGINE_THREADED
+    }
+#else
+        }
+    }
+#endif
+}
+
+#undef DISPATCH
+#undef DISPATCH_OP
+#undef CASE
+#undef NEXT
+#undef JUMP
+#undef THEN
+#undef ADD_CODE
+#undef MOVE_CODE
+#undef OUT_CODE
+#undef JZ_CODE
+#undef JNZ_CODE
+#undef SET_CODE
+#undef MUL_CODE
+#undef PROFILE_INSTRUCTION
+#undef PROFILE_TAPE
+#undef WATCH_BEFORE
+#undef WATCH_AFTER
+#undef TRACE
+#undef REACH_CELLS
+#undef COUNT_STEP
+#undef UNCOUNT_STEP
+#undef SAVE_STEPS
+#undef COUNT_RUN
+#undef CHECK_LIMITS
+#undef COUNT_BACK_EDGE
+#undef RUN_HOT_LOOP
+#undef STOP
+#undef ENGINE_NAME
+#undef ENGINE_THREADED
+#undef ENGINE_PROFILE
+#undef ENGINE_BOUNDS_CHECKS
+#undef ENGINE_TRAPS
+#undef ENGINE_WATCH
+#undef ENGINE_STEPS
+#undef ENGINE_TRACE
+#undef ENGINE_TIERED
@@ -1,272 +1,1589 @@
 #include <ctype.h>
+#include <limits.h>
+#include <stddef.h>
 #include <stdbool.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+
+#include "bf.h"
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <pthread.h>
+#define HAS_THREADS 1
+#else
+#define HAS_THREADS 0
+#endif
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#define HAS_FORK 1
+#else
+#define HAS_FORK 0
+#endif
 
-#define CODE_SIZE 50000
-#define INPUT_SIZE 20000
-#define PARENTHESES_STACK_SIZE 512
 #define BUFFER_SIZE 1024
 
-/// @brief A tape cell's value is an unsigned 8-bit integer.
-typedef unsigned char CellValue;
-
-/// @brief Defined a tape cell for an infinitely long
-///        tape in both directions.
-typedef struct TapeCell {
-    CellValue value;
-    struct TapeCell *left;
-    struct TapeCell *right;
-} TapeCell;
-
-/// @brief Creates a new tape cell not part of an existing tape.
-/// @return the tape cell
-static TapeCell *newTapeCell(void) {
-    TapeCell *result = malloc(sizeof(TapeCell));
-    result->value = 0;
-    result->left = NULL;
-    result->right = NULL;
-    return result;
+/// The watchpoints set in the visual mode.
+static Watches watches = {NULL, 0, 0, -1, 0, 0};
+
+/// What the profiling engine counted, for the profile report.
+static Profile profile;
+
+// The ahead-of-time C code generator, which writes the bytecode out as a C
+// program so that the system compiler can turn it into a native binary.
+
+/// How far the generated code lets the tape head drift before it catches up
+/// with a real pointer move, so that runs like >+>+>+ become p[1] += 1; ...
+#define MAX_PENDING_MOVE 64
+
+/// The start of every generated C program: a tape that grows in both
+/// directions, and the same decimal I/O the interpreter uses.
+static const char *const C_PROLOGUE =
+    "#include <ctype.h>\n"
+    "#include <stddef.h>\n"
+    "#include <stdio.h>\n"
+    "#include <stdlib.h>\n"
+    "#include <string.h>\n"
+    "\n"
+    "typedef unsigned char CellValue;\n"
+    "\n"
+    "static CellValue *low;\n"
+    "static CellValue *high;\n"
+    "static FILE *input;\n"
+    "\n"
+    "/* Doubles the tape, keeping the old cells in the middle, until the cell at\n"
+    "   index is at least MARGIN cells away from both ends. */\n"
+    "static inline CellValue *grow(ptrdiff_t index) {\n"
+    "    while (index < MARGIN || index >= high - low - MARGIN) {\n"
+    "        ptrdiff_t capacity = high - low;\n"
+    "        CellValue *cells = calloc(capacity * 2, sizeof(CellValue));\n"
+    "        if (cells == NULL) {\n"
+    "            fprintf(stderr, \"Out of memory for the tape\\n\");\n"
+    "            exit(EXIT_FAILURE);\n"
+    "        }\n"
+    "        memcpy(cells + capacity / 2, low, capacity);\n"
+    "        free(low);\n"
+    "        low = cells;\n"
+    "        high = cells + capacity * 2;\n"
+    "        index += capacity / 2;\n"
+    "    }\n"
+    "    return low + index;\n"
+    "}\n"
+    "\n"
+    "#define MOVE(n)                                                               \\\n"
+    "    p += (n);                                                                 \\\n"
+    "    if (p < low + MARGIN || p >= high - MARGIN) p = grow(p - low)\n"
+    "\n"
+    "/* Reads the next decimal number from the input, or 0 once it runs out. */\n"
+    "static inline CellValue readValue(void) {\n"
+    "    int next = getc(input);\n"
+    "    while (next != EOF && !isdigit(next) && next != '-') {\n"
+    "        next = getc(input);\n"
+    "    }\n"
+    "    int negative = next == '-';\n"
+    "    if (negative) {\n"
+    "        next = getc(input);\n"
+    "    }\n"
+    "    unsigned int value = 0;\n"
+    "    while (next != EOF && isdigit(next)) {\n"
+    "        value = value * 10 + (next - '0');\n"
+    "        next = getc(input);\n"
+    "    }\n"
+    "    ungetc(next, input);\n"
+    "    return negative ? -value : value;\n"
+    "}\n"
+    "\n"
+    "int main(int argc, char *argv[]) {\n"
+    "    const char *inputFileName = argc > 1 ? argv[1] : \"input.txt\";\n"
+    "    input = strcmp(inputFileName, \"-\") == 0 ? stdin : fopen(inputFileName, \"rb\");\n"
+    "    if (input == NULL) {\n"
+    "        printf(\"There was an error opening %s\\n\", inputFileName);\n"
+    "        return EXIT_FAILURE;\n"
+    "    }\n"
+    "\n"
+    "    low = calloc(4 * MARGIN, sizeof(CellValue));\n"
+    "    high = low + 4 * MARGIN;\n"
+    "    CellValue *p = low + 2 * MARGIN;\n"
+    "\n"
+    "    printf(\"Results: \");\n";
+
+/// The end of every generated C program.
+static const char *const C_EPILOGUE =
+    "    printf(\"\\nDone!\\n\");\n"
+    "    free(low);\n"
+    "    if (input != stdin) {\n"
+    "        fclose(input);\n"
+    "    }\n"
+    "    return EXIT_SUCCESS;\n"
+    "}\n";
+
+/// @brief Writes the tape head move that the generated code has put off so far.
+/// @param file the file being generated
+/// @param depth the loop nesting depth, for indentation
+/// @param pending the number of cells the tape head still has to move
+static void emitPendingMove(FILE *file, int depth, int *pending) {
+    if (*pending != 0) {
+        fprintf(file, "%*sMOVE(%d);\n", 4 * depth, "", *pending);
+        *pending = 0;
+    }
 }
 
-/// @brief Adds a new tape cell as the right neighbor of the given tape cell.
-/// @param tape the given tape cell
-static void addRightTapeCell(TapeCell *tape) {
-    tape->right = newTapeCell();
-    tape->right->left = tape;
+/// @brief Writes a compiled program out as a C program that reads its input
+///        from the file named by its first cmd line arg (input.txt by default, or - for stdin)
+///        and prints its results the same way the interpreter does.
+/// @param program the compiled program
+/// @param codeFileName the name of the BF code file, for the header comment
+/// @param file the file to write the C code to
+static void emitC(Program *program, const char *codeFileName, FILE *file) {
+    // Every cell a statement touches stays within MARGIN of the tape head.
+    int margin = MAX_PENDING_MOVE;
+    for (int i = 0; i < program->count; ++i) {
+        Instruction *instruction = &program->instructions[i];
+        bool hasCell = instruction->op != OP_JZ && instruction->op != OP_JNZ && instruction->op != OP_END;
+        int reach = hasCell ? abs(instruction->offset) : 0;
+        if (instruction->op == OP_PRODUCT && abs(PRODUCT_SOURCE(instruction->arg)) > reach) {
+            reach = abs(PRODUCT_SOURCE(instruction->arg));
+        }
+        if (reach > margin - MAX_PENDING_MOVE) {
+            margin = reach + MAX_PENDING_MOVE;
+        }
+    }
+    fprintf(file, "/* Generated by ./interpreter --emit-c from %s */\n", codeFileName);
+    fprintf(file, "#define MARGIN %d\n", margin + 1);
+    fputs(C_PROLOGUE, file);
+
+    int depth = 1;
+    int pending = 0;
+    for (int i = 0; i < program->count; ++i) {
+        Instruction *instruction = &program->instructions[i];
+        // Superinstructions are written out as their first instruction, followed by the second.
+        switch (bfBaseOp(instruction->op)) {
+            case OP_ADD:
+                fprintf(file, "%*sp[%d] += %d;\n", 4 * depth, "", pending + instruction->offset, instruction->arg);
+                break;
+            case OP_MOVE:
+                if (abs(pending + instruction->arg) > MAX_PENDING_MOVE) {
+                    emitPendingMove(file, depth, &pending);
+                }
+                pending += instruction->arg;
+                // A move too far to put off on its own happens right away.
+                if (abs(pending) > MAX_PENDING_MOVE) {
+                    emitPendingMove(file, depth, &pending);
+                }
+                break;
+            case OP_OUT:
+                fprintf(file, "%*sprintf(\"%%d \", p[%d]);\n", 4 * depth, "", pending + instruction->offset);
+                break;
+            case OP_IN:
+                fprintf(file, "%*sp[%d] = readValue();\n", 4 * depth, "", pending + instruction->offset);
+                break;
+            case OP_JZ:
+                emitPendingMove(file, depth, &pending);
+                fprintf(file, "%*swhile (*p) {\n", 4 * depth, "");
+                ++depth;
+                break;
+            case OP_JNZ:
+                emitPendingMove(file, depth, &pending);
+                --depth;
+                fprintf(file, "%*s}\n", 4 * depth, "");
+                break;
+            case OP_SET:
+                fprintf(file, "%*sp[%d] = %d;\n", 4 * depth, "", pending + instruction->offset, instruction->arg);
+                break;
+            case OP_MUL:
+                fprintf(file, "%*sp[%d] += p[%d] * %d;\n", 4 * depth, "",
+                        pending + instruction->offset, pending, instruction->arg);
+                break;
+            case OP_PRODUCT:
+                fprintf(file, "%*sp[%d] += p[%d] * p[%d] * %d;\n", 4 * depth, "",
+                        pending + instruction->offset, pending,
+                        pending + PRODUCT_SOURCE(instruction->arg), PRODUCT_FACTOR(instruction->arg));
+                break;
+            case OP_SCAN:
+                emitPendingMove(file, depth, &pending);
+                fprintf(file, "%*swhile (*p) {\n", 4 * depth, "");
+                fprintf(file, "%*sMOVE(%d);\n", 4 * (depth + 1), "", instruction->arg);
+                fprintf(file, "%*s}\n", 4 * depth, "");
+                break;
+            case OP_TRAP:  // Traps are only ever patched into programs in the visual mode.
+            case OP_END:
+            default:  // bfBaseOp() never gives a superinstruction.
+                break;
+        }
+    }
+    fputs(C_EPILOGUE, file);
 }
 
-/// @brief Adds a new tape cell as the left neighbor of the given tape cell.
-/// @param tape the given tape cell
-static void addLeftTapeCell(TapeCell *tape) {
-    tape->left = newTapeCell();
-    tape->left->right = tape;
+/// The number of hot loops and instructions listed in the profile report.
+#define PROFILE_REPORT_LENGTH 10
+
+/// The most BF code printed for a single loop or instruction in the profile report.
+#define SNIPPET_LENGTH (2 * MID_DISTANCE)
+
+/// @brief Prints the BF code between two positions on one line, cutting it
+///        short if it's too long.
+/// @param stream where to print the code
+/// @param code the BF code
+/// @param start the position of the first character to print
+/// @param end the position of the last character to print
+static void printSnippet(FILE *stream, char *code, int start, int end) {
+    int i = start;
+    for (; i <= end && i < start + SNIPPET_LENGTH && code[i]; ++i) {
+        fputc(isprint((unsigned char) code[i]) ? code[i] : ' ', stream);
+    }
+    fprintf(stream, i <= end && code[i] ? "...\n" : "\n");
 }
 
-/// @brief Destroys the entire tape that a cell is a part of.
-/// @param tape to be destroyed
-static void freeTape(TapeCell *tape) {
-    TapeCell *leftCell = tape->left;
-    TapeCell *current = leftCell;
-    while (leftCell != NULL) {
-        leftCell = leftCell->left;
-        free(current);
-        current = leftCell;
+/// @brief How much time the program spent in a single loop.
+typedef struct {
+    /// The index of the loop's OP_JZ instruction.
+    int open;
+    /// The number of instructions executed inside the loop, including nested loops.
+    unsigned long long steps;
+} LoopProfile;
+
+/// @brief Orders loop profiles from the most steps to the least, for qsort.
+static int compareLoopProfiles(const void *a, const void *b) {
+    const LoopProfile *x = a;
+    const LoopProfile *y = b;
+    return (x->steps < y->steps) - (x->steps > y->steps);
+}
+
+/// @brief Orders instructions from the most executed to the least, for qsort.
+static int compareInstructionCounts(const void *a, const void *b) {
+    unsigned long long x = profile.counts[*(const int *) a];
+    unsigned long long y = profile.counts[*(const int *) b];
+    return (x < y) - (x > y);
+}
+
+/// @brief Prints the total number of steps, the part of the tape that was
+///        used, and the hottest loops and instructions from the profile.
+/// @param stream where to print the report
+/// @param code the BF code
+/// @param program the compiled program that was profiled
+static void printProfile(FILE *stream, char *code, Program *program) {
+    // stepsBefore[i] is the number of steps taken by the instructions before i.
+    unsigned long long *stepsBefore = malloc((program->count + 1) * sizeof(unsigned long long));
+    LoopProfile *loops = malloc(program->count * sizeof(LoopProfile));
+    int *hottest = malloc(program->count * sizeof(int));
+    stepsBefore[0] = 0;
+    for (int i = 0; i < program->count; ++i) {
+        stepsBefore[i + 1] = stepsBefore[i] + profile.counts[i];
+        hottest[i] = i;
     }
-    TapeCell *rightCell = tape->right;
-    current = rightCell;
-    while (rightCell != NULL) {
-        rightCell = rightCell->right;
-        free(current);
-        current = rightCell;
+    const unsigned long long totalSteps = stepsBefore[program->count];
+    const double percent = totalSteps > 0 ? 100.0 / totalSteps : 0;
+
+    int loopCount = 0;
+    for (int i = 0; i < program->count; ++i) {
+        if (program->instructions[i].op == OP_JZ) {
+            // The loop's OP_JNZ is just before where its OP_JZ jumps to.
+            const int close = program->instructions[i].arg - 1;
+            loops[loopCount++] = (LoopProfile) {i, stepsBefore[close + 1] - stepsBefore[i]};
+        }
     }
-    free(tape);
+    qsort(loops, loopCount, sizeof(LoopProfile), compareLoopProfiles);
+    qsort(hottest, program->count, sizeof(int), compareInstructionCounts);
+
+    fprintf(stream, "\nProfile\n");
+    fprintf(stream, "Steps: %llu instructions\n", totalSteps);
+    fprintf(stream, "Tape used: cells %d to %d\n", profile.lowestTapeIndex, profile.highestTapeIndex);
+
+    fprintf(stream, "\nHot loops (steps include nested loops)\n");
+    fprintf(stream, "%4s %14s %7s %12s %14s %7s  %s\n", "rank", "steps", "%", "entries", "iterations", "pos", "code");
+    for (int rank = 0; rank < loopCount && rank < PROFILE_REPORT_LENGTH && loops[rank].steps > 0; ++rank) {
+        Instruction *open = &program->instructions[loops[rank].open];
+        Instruction *close = &program->instructions[open->arg - 1];
+        fprintf(stream, "%4d %14llu %6.2f%% %12llu %14llu %7d  ",
+                rank + 1, loops[rank].steps, loops[rank].steps * percent,
+                profile.counts[open - program->instructions],
+                profile.counts[close - program->instructions], open->pos);
+        printSnippet(stream, code, open->pos, close->pos);
+    }
+
+    fprintf(stream, "\nHot instructions\n");
+    fprintf(stream, "%4s %14s %7s %6s %6s %6s %7s  %s\n", "rank", "count", "%", "op", "arg", "offset", "pos", "code");
+    for (int rank = 0; rank < program->count && rank < PROFILE_REPORT_LENGTH && profile.counts[hottest[rank]] > 0; ++rank) {
+        Instruction *instruction = &program->instructions[hottest[rank]];
+        fprintf(stream, "%4d %14llu %6.2f%% %6s %6d %6d %7d  ",
+                rank + 1, profile.counts[hottest[rank]], profile.counts[hottest[rank]] * percent,
+                bfOpNames[instruction->op], instruction->arg, instruction->offset, instruction->pos);
+        if (instruction->op == OP_END) {
+            fputc('\n', stream);
+        } else {
+            printSnippet(stream, code, instruction->pos, instruction->pos + MID_DISTANCE / 3);
+        }
+    }
+
+    free(stepsBefore);
+    free(loops);
+    free(hottest);
 }
 
-/// The initial value for the tape index.
-#define STARTING_TAPE_INDEX 0
+/// The number of tape cells in each page of a snapshot.
+#define SNAPSHOT_PAGE_SIZE 4096
 
-/// The hypothetical index into the infinitely long tape.
-/// A value of 0 corresponds to the initial tape cell.
-/// Negative values correspond to tape cells to the left of the initial cell.
-/// Positive values correspond to tape cells to the right of the initial cell.
-static int theTapeIndex = STARTING_TAPE_INDEX;
+/// The number of steps between snapshots unless --snapshot-interval says otherwise.
+#define DEFAULT_SNAPSHOT_INTERVAL (1 << 20)
 
-/// The output buffer containing the results of having executed the BF code.
-static char outputBuffer[BUFFER_SIZE] = {0};
+/// The MiB of memory the snapshots can use unless --snapshot-memory says otherwise.
+#define DEFAULT_SNAPSHOT_MEMORY 64
 
-/// The output buffer index to indicate how much of the buffer has been used up.
-static unsigned int outputBufferIndex = 0;
+/// @brief A page of tape cells saved by a snapshot, which is shared with the
+///        snapshots after it for as long as the cells in it stay the same.
+typedef struct {
+    /// The number of snapshots the page is a part of.
+    int references;
+    CellValue cells[SNAPSHOT_PAGE_SIZE];
+} SnapshotPage;
 
-/// @brief Processes the command from the code at the given codeIndex using the given tape and input stream.
-/// @param code the BF code string
-/// @param codeIndex the address of the index into the BF code string
-/// @param tape the tape to execute the code on
-/// @param input the input stream
-void process(
-        char *code,
-        int *codeIndex,
-        TapeCell **tape,
-        CellValue *input) {
-    // Static variables
-    static int parenthesesStack[PARENTHESES_STACK_SIZE];
-    static int parenthesesStackCounter = 0;
-    static int inputPtr = 0;
-    
-    // Main switch statement
-    switch (code[*codeIndex]) {
-        case '+':
-            (*tape)->value++;
+/// @brief Everything needed to go back to a step in the visual mode.
+typedef struct {
+    unsigned long long step;
+    /// The index of the next instruction to run.
+    int next;
+    int tapeIndex;
+    /// Where the input stream was in its file.
+    long inputPosition;
+    /// How much output there was.
+    size_t outputLength;
+    /// The number of the first page, where page n holds the cells from tape
+    /// index n * SNAPSHOT_PAGE_SIZE on.
+    int firstPage;
+    int pageCount;
+    SnapshotPage **pages;
+} Snapshot;
+
+/// @brief The snapshots taken so far by the visual mode, in step order.
+typedef struct {
+    Snapshot *list;
+    int count;
+    int capacity;
+    /// The number of steps between snapshots, or 0 to only take the first one.
+    unsigned long long interval;
+    /// The most memory the snapshots can use before every other one is dropped.
+    size_t memoryBudget;
+    /// The memory the snapshots are using.
+    size_t memoryUsed;
+} Snapshots;
+
+/// The snapshots the visual mode can go back to.
+static Snapshots snapshots = {NULL, 0, 0, DEFAULT_SNAPSHOT_INTERVAL, (size_t) DEFAULT_SNAPSHOT_MEMORY << 20, 0};
+
+/// @brief Finds the snapshot page a tape cell belongs in.
+/// @param tapeIndex the tape index of the cell
+/// @return the number of the page
+static int snapshotPageOf(int tapeIndex) {
+    return tapeIndex >= 0 ? tapeIndex / SNAPSHOT_PAGE_SIZE : -((-tapeIndex - 1) / SNAPSHOT_PAGE_SIZE) - 1;
+}
+
+/// @brief Finds the part of a snapshot page that is on the tape.
+/// @param tape the tape
+/// @param page the number of the page
+/// @param from where to put the first tape index of the part
+/// @param to where to put the tape index just past the part
+static void tapePartOfPage(Tape *tape, int page, int *from, int *to) {
+    int first, end;
+    bfUsedTapeIndices(tape, &first, &end);
+    const int start = page * SNAPSHOT_PAGE_SIZE;
+    *from = start > first ? start : first;
+    *to = start + SNAPSHOT_PAGE_SIZE < end ? start + SNAPSHOT_PAGE_SIZE : end;
+}
+
+/// @brief Lets go of a snapshot, freeing the pages no other snapshot shares.
+/// @param snapshot the snapshot
+static void freeSnapshot(Snapshot *snapshot) {
+    for (int i = 0; i < snapshot->pageCount; ++i) {
+        if (--snapshot->pages[i]->references == 0) {
+            free(snapshot->pages[i]);
+            snapshots.memoryUsed -= sizeof(SnapshotPage);
+        }
+    }
+    free(snapshot->pages);
+    snapshots.memoryUsed -= snapshot->pageCount * sizeof(SnapshotPage *);
+}
+
+/// @brief Saves the state of the visual mode at the current step, sharing
+///        every page of the tape that hasn't changed since the last snapshot.
+///        Once the snapshots go over their memory budget every other one is
+///        dropped and the interval between them doubles.
+/// @param machine the machine running the code
+/// @param next the index of the next instruction to run
+static void takeSnapshot(BFMachine *machine, int next) {
+    Tape *tape = &machine->tape;
+    Snapshot snapshot = {machine->steps, next, tape->head, bfInputPosition(machine->input), machine->output.index, 0, 0, NULL};
+    int first, end;
+    bfUsedTapeIndices(tape, &first, &end);
+    if (first < end) {
+        snapshot.firstPage = snapshotPageOf(first);
+        snapshot.pageCount = snapshotPageOf(end - 1) - snapshot.firstPage + 1;
+    }
+    snapshot.pages = malloc(snapshot.pageCount * sizeof(SnapshotPage *));
+    snapshots.memoryUsed += snapshot.pageCount * sizeof(SnapshotPage *);
+
+    Snapshot *previous = snapshots.count > 0 ? &snapshots.list[snapshots.count - 1] : NULL;
+    static CellValue cells[SNAPSHOT_PAGE_SIZE];
+    for (int i = 0; i < snapshot.pageCount; ++i) {
+        const int page = snapshot.firstPage + i;
+        int from, to;
+        tapePartOfPage(tape, page, &from, &to);
+        memset(cells, 0, SNAPSHOT_PAGE_SIZE);
+        memcpy(&cells[from - page * SNAPSHOT_PAGE_SIZE], &tape->cells[tape->origin + from], to - from);
+
+        SnapshotPage *shared = NULL;
+        if (previous != NULL && page >= previous->firstPage && page < previous->firstPage + previous->pageCount) {
+            shared = previous->pages[page - previous->firstPage];
+        }
+        if (shared != NULL && memcmp(shared->cells, cells, SNAPSHOT_PAGE_SIZE) == 0) {
+            ++shared->references;
+            snapshot.pages[i] = shared;
+        } else {
+            snapshot.pages[i] = malloc(sizeof(SnapshotPage));
+            snapshot.pages[i]->references = 1;
+            memcpy(snapshot.pages[i]->cells, cells, SNAPSHOT_PAGE_SIZE);
+            snapshots.memoryUsed += sizeof(SnapshotPage);
+        }
+    }
+
+    if (snapshots.count >= snapshots.capacity) {
+        snapshots.capacity = snapshots.capacity == 0 ? 64 : snapshots.capacity * 2;
+        snapshots.list = realloc(snapshots.list, snapshots.capacity * sizeof(Snapshot));
+    }
+    snapshots.list[snapshots.count++] = snapshot;
+
+    // Snapshots are only ever taken at multiples of the interval, so
+    // dropping every other one leaves them at multiples of twice of it.
+    while (snapshots.memoryUsed > snapshots.memoryBudget && snapshots.count > 1) {
+        int kept = 0;
+        for (int i = 0; i < snapshots.count; ++i) {
+            if (i % 2 == 0) {
+                snapshots.list[kept++] = snapshots.list[i];
+            } else {
+                freeSnapshot(&snapshots.list[i]);
+            }
+        }
+        snapshots.count = kept;
+        snapshots.interval *= 2;
+    }
+}
+
+/// @brief Puts the visual mode back the way it was when a snapshot was taken.
+/// @param snapshot the snapshot
+/// @param machine the machine running the code, whose tape can only have
+///        grown since the snapshot
+/// @return the index of the next instruction to run, or -1 without changing
+///         anything if the input can't be read again from where it was
+static int restoreSnapshot(Snapshot *snapshot, BFMachine *machine) {
+    if (!bfSeekInput(machine->input, snapshot->inputPosition)) {
+        return -1;
+    }
+    Tape *tape = &machine->tape;
+    int first, end;
+    bfUsedTapeIndices(tape, &first, &end);
+    if (first < end) {
+        memset(&tape->cells[tape->origin + first], 0, end - first);
+    }
+    for (int i = 0; i < snapshot->pageCount; ++i) {
+        const int page = snapshot->firstPage + i;
+        int from, to;
+        tapePartOfPage(tape, page, &from, &to);
+        memcpy(&tape->cells[tape->origin + from], &snapshot->pages[i]->cells[from - page * SNAPSHOT_PAGE_SIZE], to - from);
+    }
+    machine->steps = snapshot->step;
+    tape->head = snapshot->tapeIndex;
+    machine->output.index = snapshot->outputLength;
+    return snapshot->next;
+}
+
+/// @brief Lets go of every snapshot.
+static void freeSnapshots(void) {
+    for (int i = 0; i < snapshots.count; ++i) {
+        freeSnapshot(&snapshots.list[i]);
+    }
+    free(snapshots.list);
+    snapshots.list = NULL;
+    snapshots.count = 0;
+    snapshots.capacity = 0;
+}
+
+/// @brief Says why a machine stopped before the end of its program.
+/// @param reason why it stopped, which isn't STOP_END
+/// @return the reason, to go after "Stopped: "
+static const char *describeStop(StopReason reason) {
+    switch (reason) {
+        case STOP_STEP_LIMIT:
+            return "ran past the step limit";
+        case STOP_DEADLINE:
+            return "ran past the time limit";
+        case STOP_TAPE:
+            return "the tape head ran off the end of the tape";
+        case STOP_END:
+        case STOP_MEMORY:
             break;
-        case '-':
-            (*tape)->value--;
+    }
+    return "ran out of memory for the output";
+}
+
+/// @brief Runs the program until it reaches one of the traps set in it
+///        (or a watchpoint, or a step), taking snapshots along the way, and
+///        then takes the traps back out. Running out of tape or memory ends
+///        the interpreter.
+/// @param machine the machine running the program, which was compiled with
+///        an instruction for every BF character
+/// @param traps the traps patched into the program
+/// @param next the index of the next instruction to run, which is run even if it is a trap
+/// @param untilStep the step to stop at, or ULLONG_MAX to not stop at any step
+/// @return the index of the next instruction to run
+static int runToTraps(BFMachine *machine, Traps *traps, int next, unsigned long long untilStep) {
+    watches.hit = -1;
+    for (;;) {
+        unsigned long long snapshotStep = ULLONG_MAX;
+        if (snapshots.interval > 0 && snapshots.count > 0) {
+            snapshotStep = snapshots.list[snapshots.count - 1].step + snapshots.interval;
+        }
+        machine->stepLimit = snapshotStep < untilStep ? snapshotStep : untilStep;
+
+        // Only pays for the watch hooks while there are watchpoints.
+        next = bfRunUntilTrap(machine, next, traps);
+        if (machine->stopReason != STOP_END) {
+            printf("\nStopped: %s\n", describeStop(machine->stopReason));
+            exit(EXIT_FAILURE);
+        }
+        if (machine->steps == snapshotStep) {
+            takeSnapshot(machine, next);
+        }
+
+        // Anything but a snapshot stops the run. Carrying on from a trap would
+        // skip it, so a trap reached right at a snapshot stops the run too.
+        OpCode op = machine->program->instructions[next].op;
+        if (op == OP_TRAP || op == OP_END || watches.hit >= 0 || machine->steps >= untilStep) {
             break;
-        case '>':
-            if ((*tape)->right == NULL) {
-                addRightTapeCell(*tape);
-            }
-            (*tape) = (*tape)->right;
-            ++theTapeIndex;
+        }
+    }
+    bfClearTraps(machine->program, traps);
+    return next;
+}
+
+/// @brief Goes to a step of the visual mode, going back to the last snapshot
+///        before it if the step has already been run, and then running
+///        forward to it without stopping at the watchpoints.
+/// @param machine the machine running the program, which was compiled with
+///        an instruction for every BF character
+/// @param traps the traps patched into the program
+/// @param next the index of the next instruction to run
+/// @param step the step to go to, which it stays away from if it would have
+///        to go back but the input can't be read again (like from a pipe)
+/// @return the index of the next instruction to run
+static int goToStep(BFMachine *machine, Traps *traps, int next, unsigned long long step) {
+    watches.hit = -1;
+    if (step < machine->steps) {
+        int i = snapshots.count - 1;
+        while (snapshots.list[i].step > step) {
+            --i;
+        }
+        const int restored = restoreSnapshot(&snapshots.list[i], machine);
+        if (restored < 0) {
+            printf("Can't go back, since the input can't be read again\n");
+            return next;
+        }
+        next = restored;
+    }
+    if (step > machine->steps) {
+        const int watchCount = watches.count;
+        watches.count = 0;
+        next = runToTraps(machine, traps, next, step);
+        watches.count = watchCount;
+    }
+    return next;
+}
+
+/// @brief Sets traps that stop the program as soon as it gets past a position in the code.
+/// @param program the program, compiled with an instruction for every BF character
+/// @param traps the traps patched into the program
+/// @param position the position in the BF code
+static void trapPastPosition(Program *program, Traps *traps, int position) {
+    // Execution only ever skips forward when a loop is skipped, so the first
+    // instruction past the position and the instructions just after the loops
+    // that start before it and end after it are the only ways past it.
+    for (int i = 0; i < program->count; ++i) {
+        if (program->instructions[i].pos > position) {
+            bfSetTrap(program, traps, i);
             break;
-        case '<':
-            if ((*tape)->left == NULL) {
-                addLeftTapeCell(*tape);
-            }
-            (*tape) = (*tape)->left;
-            --theTapeIndex;
+        }
+        int target = program->instructions[i].arg;
+        if (bfOriginalOp(program, traps, i) == OP_JZ && program->instructions[target].pos > position) {
+            bfSetTrap(program, traps, target);
+        }
+    }
+}
+
+/// @brief Finds the innermost loop that an instruction is inside of.
+/// @param program the program, compiled with an instruction for every BF character
+/// @param traps the traps patched into the program
+/// @param index the index of the instruction
+/// @return the index of the loop's OP_JZ instruction, or -1 if it isn't in a loop
+static int enclosingLoop(Program *program, Traps *traps, int index) {
+    int depth = 0;
+    for (int i = index - 1; i >= 0; --i) {
+        OpCode op = bfOriginalOp(program, traps, i);
+        if (op == OP_JNZ) {
+            ++depth;
+        } else if (op == OP_JZ && depth-- == 0) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+/// @brief Sets traps on every instruction that could run right after the given one.
+/// @param program the program, compiled with an instruction for every BF character
+/// @param traps the traps patched into the program
+/// @param index the index of the instruction
+static void trapNextStep(Program *program, Traps *traps, int index) {
+    OpCode op = bfOriginalOp(program, traps, index);
+    bfSetTrap(program, traps, index + 1);
+    if (op == OP_JZ || op == OP_JNZ) {
+        bfSetTrap(program, traps, program->instructions[index].arg);
+    }
+}
+
+/// Wrapper macro around the loadFile function that gives an error mesage
+/// and crashes the program if there was an error.
+#define READ_FILE(fileName, contents)                                         \
+    if (!bfLoadFile((fileName), &(contents))) {                                 \
+        printf("There was an error opening %s\n", (fileName));                \
+        return EXIT_FAILURE;                                                  \
+    }
+
+/// @brief Runs the code again on the reference bfProcess() path and compares the
+/// output, the final tape index, and the tape with what the engine produced.
+/// All of the engine's output has to still be in the output buffer.
+/// @param code the BF code string
+/// @param jumps the jump table of the BF code's brackets
+/// @param machine the machine the engine finished running the code on
+/// @return true if the engine and the reference agree
+static bool compareWithReference(char *code, int *jumps, BFMachine *machine) {
+    if (!bfRewindInput(machine->input)) {
+        fprintf(stderr, "The input can't be read again to compare with the reference\n");
+        return false;
+    }
+
+    BFMachine reference = bfNewMachine(NULL, machine->input, false);
+    reference.output.raw = machine->output.raw;
+    for (int codePtr = 0; code[codePtr]; ++codePtr) {
+        if (!bfProcess(code, jumps, &codePtr, &reference)) {
+            fprintf(stderr, "The reference interpreter stopped: %s\n", describeStop(reference.stopReason));
             break;
-        case '.':
-            outputBufferIndex += snprintf(&(outputBuffer[outputBufferIndex]), BUFFER_SIZE, "%d ", (*tape)->value);
+        }
+    }
+
+    bool agreed = true;
+    Output *output = &machine->output;
+    Output *referenceOutput = &reference.output;
+    if (output->index != referenceOutput->index ||
+        (output->index > 0 && memcmp(output->buffer, referenceOutput->buffer, output->index) != 0)) {
+        size_t i = 0;
+        while (i < output->index && i < referenceOutput->index && output->buffer[i] == referenceOutput->buffer[i]) {
+            ++i;
+        }
+        fprintf(stderr, "Output mismatch at byte %zu: the engine wrote %zu bytes, the reference %zu\n",
+                i, output->index, referenceOutput->index);
+        agreed = false;
+    }
+    Tape *tape = &machine->tape;
+    if (tape->head != reference.tape.head) {
+        fprintf(stderr, "Tape index mismatch: engine %d, reference %d\n", tape->head, reference.tape.head);
+        agreed = false;
+    }
+    int low, high, referenceLow, referenceHigh;
+    bfUsedTapeIndices(tape, &low, &high);
+    bfUsedTapeIndices(&reference.tape, &referenceLow, &referenceHigh);
+    low = low < referenceLow ? low : referenceLow;
+    high = high > referenceHigh ? high : referenceHigh;
+    for (int i = low; i < high; ++i) {
+        if (bfPeekCell(tape, i) != bfPeekCell(&reference.tape, i)) {
+            fprintf(stderr, "Tape mismatch at cell %d: engine %d, reference %d\n",
+                    i, bfPeekCell(tape, i), bfPeekCell(&reference.tape, i));
+            agreed = false;
             break;
-        case ',':
-            while (isdigit(input[inputPtr])) {
-                ++inputPtr;
+        }
+    }
+
+    bfFreeMachine(&reference);
+    return agreed;
+}
+
+/// @brief The options given on the cmd line.
+typedef struct {
+    const Engine *engine;
+    bool benchScan;
+    bool compare;
+    /// The file to write the code out to as C instead of running it, or NULL.
+    const char *emitC;
+    /// The file to write the results to instead of stdout, or NULL.
+    const char *outputFileName;
+    bool rawOutput;
+    bool rawInput;
+    bool profile;
+    bool virtualTape;
+    bool benchTape;
+    unsigned long long snapshotInterval;
+    unsigned long long snapshotMemory;
+    /// Whether to run the code file on every input file given after it.
+    bool batch;
+    /// The file listing the code and input file of every job to run, or NULL.
+    const char *batchList;
+    /// The number of worker threads in batch mode, or 0 for one per core.
+    unsigned long long jobs;
+    /// The most steps the code can run before it is stopped.
+    unsigned long long maxSteps;
+    /// The most milliseconds the code can run before it is stopped, or 0 for no limit.
+    unsigned long long timeout;
+    /// The list of benchmark programs to time every engine on, or NULL.
+    const char *bench;
+    /// The number of times each engine runs each benchmark program.
+    unsigned long long benchRuns;
+    /// The list of benchmark programs to count sequences of operations in, or NULL.
+    const char *dumpNgrams;
+    /// The file to record a trace of every step to, or NULL.
+    const char *trace;
+} Options;
+
+/// The exit status when the code runs past the step limit set by --max-steps.
+#define EXIT_STEP_LIMIT 3
+
+/// The exit status when the code runs past the time limit set by --timeout.
+#define EXIT_TIME_LIMIT 4
+
+/// @brief A single run of a program on an input file in batch mode.
+typedef struct {
+    const char *codeFileName;
+    const char *inputFileName;
+    /// The compiled program, shared with every other job with the same code file.
+    Program *program;
+    /// The results, which are kept until every job before this one is printed.
+    Output output;
+    unsigned long long steps;
+    double milliseconds;
+    /// Whether the input file could be opened.
+    bool opened;
+    /// Why the job stopped running.
+    StopReason stopReason;
+    /// The number of times --bench runs the program back to back in each
+    /// timed run, which is 1 unless its line in the corpus says otherwise.
+    unsigned long long repeats;
+} BatchJob;
+
+/// @brief A program compiled for batch mode, along with the file it came from.
+typedef struct {
+    const char *codeFileName;
+    Program program;
+} BatchProgram;
+
+/// @brief The jobs a worker hasn't started yet, which are the jobs from
+///        front up to back. The worker takes them from the front, and other
+///        workers that run out of jobs of their own steal them from the back.
+typedef struct {
+#if HAS_THREADS
+    pthread_mutex_t lock;
+#endif
+    int front;
+    int back;
+} WorkQueue;
+
+/// @brief Everything the workers in batch mode share.
+typedef struct {
+    BatchJob *jobs;
+    int jobCount;
+    /// The work queue of each worker.
+    WorkQueue *queues;
+    int workerCount;
+    const Options *options;
+} Batch;
+
+/// @brief A worker thread in batch mode.
+typedef struct {
+    Batch *batch;
+    /// The index of the worker's own work queue.
+    int index;
+} Worker;
+
+/// @brief Takes a job from the back of a work queue if it has any left.
+/// @param queue the work queue
+/// @param fromFront whether to take the job from the front instead
+/// @return the index of the job, or -1 if the queue is empty
+static int takeFromQueue(WorkQueue *queue, bool fromFront) {
+    int job = -1;
+#if HAS_THREADS
+    pthread_mutex_lock(&queue->lock);
+#endif
+    if (queue->front < queue->back) {
+        job = fromFront ? queue->front++ : --queue->back;
+    }
+#if HAS_THREADS
+    pthread_mutex_unlock(&queue->lock);
+#endif
+    return job;
+}
+
+/// @brief Finds the next job for a worker, stealing one from another worker
+///        once its own queue runs out. No jobs are added once the workers
+///        start, so there are none left once every queue is empty.
+/// @param batch the batch
+/// @param worker the index of the worker
+/// @return the index of the job, or -1 if there are no jobs left
+static int takeJob(Batch *batch, int worker) {
+    int job = takeFromQueue(&batch->queues[worker], true);
+    for (int i = 1; job < 0 && i < batch->workerCount; ++i) {
+        job = takeFromQueue(&batch->queues[(worker + i) % batch->workerCount], false);
+    }
+    return job;
+}
+
+/// @brief Runs a job on a machine of its own, counting its steps and timing it.
+/// @param batch the batch
+/// @param job the job
+static void runBatchJob(Batch *batch, BatchJob *job) {
+    const Options *options = batch->options;
+    double begin = bfNanoseconds();
+    Input *input = bfOpenInput(job->inputFileName, options->rawInput);
+    job->opened = input != NULL;
+    if (input == NULL) {
+        return;
+    }
+    BFMachine machine = bfNewMachine(job->program, input, options->virtualTape);
+    machine.output.raw = options->rawOutput;
+    machine.stepLimit = options->maxSteps;
+    if (options->timeout > 0) {
+        machine.deadline = begin + options->timeout * 1e6;
+    }
+    bfRunMachine(&machine, options->engine);
+    job->steps = machine.steps;
+    job->stopReason = machine.stopReason;
+    // Hand the results over to the job so they outlive the machine.
+    job->output = machine.output;
+    machine.output.buffer = NULL;
+    bfFreeMachine(&machine);
+    bfCloseInput(input);
+    job->milliseconds = (bfNanoseconds() - begin) / 1e6;
+}
+
+/// @brief Runs jobs until there are none left.
+/// @param argument the worker
+/// @return NULL
+static void *runWorker(void *argument) {
+    Worker *worker = argument;
+    int job;
+    while ((job = takeJob(worker->batch, worker->index)) >= 0) {
+        runBatchJob(worker->batch, &worker->batch->jobs[job]);
+    }
+    return NULL;
+}
+
+/// @brief Reads a whole number from an option, a list or a visual mode command.
+/// @param text the text of the number, which may have spaces around it
+/// @param value where to put the number
+/// @return true if the text is a whole number
+static bool parseCount(const char *text, unsigned long long *value) {
+    while (isspace((unsigned char) *text)) {
+        ++text;
+    }
+    char *end;
+    *value = strtoull(text, &end, 10);
+    while (isspace((unsigned char) *end)) {
+        ++end;
+    }
+    return isdigit((unsigned char) *text) && *end == '\0';
+}
+
+/// @brief Copies the next whitespace separated word out of a line.
+/// @param line the address of where the line is up to, which is moved past the word
+/// @param end where the line ends
+/// @return the word, or NULL if there are no more words in the line
+static char *nextWord(const char **line, const char *end) {
+    const char *start = *line;
+    while (start < end && isspace((unsigned char) *start)) {
+        ++start;
+    }
+    const char *stop = start;
+    while (stop < end && !isspace((unsigned char) *stop)) {
+        ++stop;
+    }
+    *line = stop;
+    if (start == stop) {
+        return NULL;
+    }
+    char *word = malloc(stop - start + 1);
+    memcpy(word, start, stop - start);
+    word[stop - start] = '\0';
+    return word;
+}
+
+/// @brief Reads the jobs out of a batch list, which has a code file and an
+///        input file on each line separated by whitespace, optionally followed
+///        by the repeat count --bench uses, so that a benchmark corpus is a
+///        batch list too.
+/// @param fileName the name of the batch list
+/// @param jobs where to put the jobs
+/// @param jobCount where to put the number of jobs
+/// @return true if the list could be read and every line in it is valid
+static bool readBatchList(const char *fileName, BatchJob **jobs, int *jobCount) {
+    FileContents list;
+    if (!bfLoadFile(fileName, &list)) {
+        printf("There was an error opening %s\n", fileName);
+        return false;
+    }
+    int capacity = 0;
+    int lineNumber = 0;
+    bool valid = true;
+    const char *line = list.data;
+    const char *fileEnd = list.data + list.size;
+    while (valid && line < fileEnd) {
+        const char *lineEnd = memchr(line, '\n', fileEnd - line);
+        lineEnd = lineEnd == NULL ? fileEnd : lineEnd;
+        ++lineNumber;
+        char *codeFileName = nextWord(&line, lineEnd);
+        char *inputFileName = nextWord(&line, lineEnd);
+        char *repeatCount = nextWord(&line, lineEnd);
+        char *extra = nextWord(&line, lineEnd);
+        unsigned long long count = 1;
+        if (codeFileName != NULL && (inputFileName == NULL || extra != NULL ||
+                                     (repeatCount != NULL && (!parseCount(repeatCount, &count) || count == 0)))) {
+            fprintf(stderr, "Line %d of %s should be a code file and an input file, optionally followed by a repeat count\n",
+                    lineNumber, fileName);
+            free(codeFileName);
+            free(inputFileName);
+            valid = false;
+        } else if (codeFileName != NULL) {
+            if (*jobCount >= capacity) {
+                capacity = capacity == 0 ? 64 : capacity * 2;
+                *jobs = realloc(*jobs, capacity * sizeof(BatchJob));
             }
-            while (!isdigit(input[inputPtr]) && input[inputPtr] != '-') {
-                ++inputPtr;
+            (*jobs)[(*jobCount)++] = (BatchJob) {
+                .codeFileName = codeFileName, .inputFileName = inputFileName, .repeats = count,
+            };
+        }
+        free(repeatCount);
+        free(extra);
+        line = lineEnd + 1;
+    }
+    bfUnloadFile(&list);
+    return valid;
+}
+
+/// @brief Runs every job in a batch on a pool of worker threads, one per
+///        core unless told otherwise. Each code file is only compiled once,
+///        and every job running it shares the bytecode. The results are
+///        printed in the order of the jobs, each with how many steps it took
+///        and how long it ran for.
+/// @param jobs the jobs, which have their code and input files filled in
+/// @param jobCount the number of jobs
+/// @param options the options to run every job with
+/// @return EXIT_SUCCESS if every job ran to the end, EXIT_FAILURE if any
+///         couldn't run, and otherwise the exit status of the limit that
+///         stopped a job
+static int runBatch(BatchJob *jobs, int jobCount, const Options *options) {
+    // Compile each code file once, in the order they first show up.
+    BatchProgram *programs = malloc(jobCount * sizeof(BatchProgram));
+    int programCount = 0;
+    bool compiled = true;
+    for (int i = 0; i < jobCount && compiled; ++i) {
+        int p = 0;
+        while (p < programCount && strcmp(programs[p].codeFileName, jobs[i].codeFileName) != 0) {
+            ++p;
+        }
+        if (p == programCount) {
+            FileContents codeFile;
+            if (!bfLoadFile(jobs[i].codeFileName, &codeFile)) {
+                printf("There was an error opening %s\n", jobs[i].codeFileName);
+                compiled = false;
+                break;
             }
-            (*tape)->value = atoi((const char *) &input[inputPtr]);
-            break;
-        case '[':
-            if ((*tape)->value != 0) {
-                if (parenthesesStack[parenthesesStackCounter] != *codeIndex) {
-                    parenthesesStack[++parenthesesStackCounter] = *codeIndex;
+            programs[p].codeFileName = jobs[i].codeFileName;
+            programs[p].program = (Program) {0};
+            ++programCount;
+            if (!bfCompile(codeFile.data, &programs[p].program, true)) {
+                fprintf(stderr, "The brackets in %s are unbalanced\n", jobs[i].codeFileName);
+                compiled = false;
+            }
+            bfUnloadFile(&codeFile);
+        }
+        jobs[i].program = &programs[p].program;
+    }
+
+    int result = compiled ? EXIT_SUCCESS : EXIT_FAILURE;
+    if (compiled) {
+        // Split the jobs up evenly between the workers to start with.
+        int threads = (int) options->jobs;
+#if HAS_THREADS
+        if (threads <= 0) {
+            threads = (int) sysconf(_SC_NPROCESSORS_ONLN);
+        }
+#else
+        threads = 1;
+#endif
+        threads = threads < 1 ? 1 : threads > jobCount ? jobCount : threads;
+        Batch batch = {jobs, jobCount, malloc(threads * sizeof(WorkQueue)), threads, options};
+        Worker *workers = malloc(threads * sizeof(Worker));
+        for (int w = 0; w < threads; ++w) {
+#if HAS_THREADS
+            pthread_mutex_init(&batch.queues[w].lock, NULL);
+#endif
+            batch.queues[w].front = (int) ((long long) jobCount * w / threads);
+            batch.queues[w].back = (int) ((long long) jobCount * (w + 1) / threads);
+            workers[w] = (Worker) {&batch, w};
+        }
+
+        double begin = bfNanoseconds();
+#if HAS_THREADS
+        // The first worker is this thread, so one thread means no threads.
+        // If a thread can't be started, the others steal its queue instead.
+        pthread_t *ids = malloc(threads * sizeof(pthread_t));
+        int started = 1;
+        while (started < threads && pthread_create(&ids[started], NULL, runWorker, &workers[started]) == 0) {
+            ++started;
+        }
+        if (started < threads) {
+            fprintf(stderr, "Only %d of %d worker threads could be started\n", started, threads);
+        }
+        runWorker(&workers[0]);
+        for (int w = 1; w < started; ++w) {
+            pthread_join(ids[w], NULL);
+        }
+        free(ids);
+        for (int w = 0; w < threads; ++w) {
+            pthread_mutex_destroy(&batch.queues[w].lock);
+        }
+#else
+        runWorker(&workers[0]);
+#endif
+        double milliseconds = (bfNanoseconds() - begin) / 1e6;
+
+        for (int i = 0; i < jobCount; ++i) {
+            printf("Job %d: %s %s\n", i + 1, jobs[i].codeFileName, jobs[i].inputFileName);
+            if (!jobs[i].opened) {
+                printf("There was an error opening %s\n", jobs[i].inputFileName);
+                result = EXIT_FAILURE;
+                continue;
+            }
+            printf("Results: ");
+            if (jobs[i].output.index > 0) {
+                fwrite(jobs[i].output.buffer, 1, jobs[i].output.index, stdout);
+            }
+            printf("\nSteps: %llu, time: %.3f ms\n", jobs[i].steps, jobs[i].milliseconds);
+            const StopReason stopReason = jobs[i].stopReason;
+            if (stopReason != STOP_END) {
+                printf("Stopped: %s\n", describeStop(stopReason));
+                if (result == EXIT_SUCCESS) {
+                    result = stopReason == STOP_STEP_LIMIT ? EXIT_STEP_LIMIT :
+                             stopReason == STOP_DEADLINE ? EXIT_TIME_LIMIT : EXIT_FAILURE;
                 }
+            }
+            free(jobs[i].output.buffer);
+        }
+        printf("Ran %d jobs on %d threads in %.3f ms\n", jobCount, threads, milliseconds);
+        free(batch.queues);
+        free(workers);
+    }
+
+    for (int p = 0; p < programCount; ++p) {
+        free(programs[p].program.instructions);
+    }
+    free(programs);
+    return result;
+}
+
+/// The benchmark corpus --bench runs when it isn't given one.
+#define DEFAULT_BENCH_CORPUS "bench/corpus.txt"
+
+/// The number of times each engine runs each benchmark program by default.
+#define DEFAULT_BENCH_RUNS 5
+
+/// The name the legacy bfProcess() path goes by in the benchmark results.
+#define PROCESS_ENGINE_NAME "process"
+
+/// @brief What an engine did over every run of a benchmark program.
+typedef struct {
+    /// The steps of a single run, which are BF commands for bfProcess() and
+    /// bytecode instructions for the engines.
+    unsigned long long steps;
+    double bestMilliseconds;
+    double medianMilliseconds;
+    /// The FNV-1a hash of the output of the first run.
+    unsigned long long checksum;
+    /// Whether every run had the same output.
+    bool consistent;
+} BenchResult;
+
+/// @brief Hashes a chunk of the output into a running FNV-1a hash instead of writing it out.
+/// @param hash the address of the hash so far
+/// @param data the bytes to hash
+/// @param length the number of bytes
+static void hashOutput(void *hash, const char *data, size_t length) {
+    unsigned long long value = *(unsigned long long *) hash;
+    for (size_t i = 0; i < length; ++i) {
+        value = (value ^ (unsigned char) data[i]) * 0x100000001b3ULL;
+    }
+    *(unsigned long long *) hash = value;
+}
+
+/// @brief Compares two run times for qsort.
+static int compareTimes(const void *a, const void *b) {
+    const double first = *(const double *) a;
+    const double second = *(const double *) b;
+    return (first > second) - (first < second);
+}
+
+/// @brief Runs a benchmark program a number of times on one engine, timing
+///        each run from the machine being made to its last output being
+///        hashed. Each timed run can go through the program several times
+///        back to back, so that fast engines run long enough to be timed
+///        well, and its time is then divided between them.
+/// @param code the BF code with everything but the commands stripped out
+/// @param jumps the jump table of the BF code's brackets
+/// @param program the compiled program
+/// @param inputFileName the input file, which is read from the start every time
+/// @param engine the engine, or NULL for the legacy bfProcess() path
+/// @param runs the number of timed runs
+/// @param repeats the number of times each timed run goes through the program
+/// @param result where to put what the runs did
+/// @return true if the input file could be opened
+static bool timeEngine(char *code, int *jumps, Program *program, const char *inputFileName,
+                       const Engine *engine, int runs, unsigned long long repeats, BenchResult *result) {
+    double *times = malloc(runs * sizeof(double));
+    Input *input = bfOpenInput(inputFileName, false);
+    result->consistent = true;
+    for (int r = 0; r < runs && input != NULL; ++r) {
+        times[r] = 0;
+        for (unsigned long long k = 0; k < repeats; ++k) {
+            // Going back to the start of the input isn't part of the time.
+            bfRewindInput(input);
+            unsigned long long hash = 0xcbf29ce484222325ULL;
+            double begin = bfNanoseconds();
+            BFMachine machine = bfNewMachine(engine != NULL ? program : NULL, input, false);
+            machine.output.write = hashOutput;
+            machine.output.context = &hash;
+            if (engine != NULL) {
+                bfRunMachine(&machine, engine);
             } else {
-                if (parenthesesStack[parenthesesStackCounter] == *codeIndex) {
-                    --parenthesesStackCounter;
-                }
-                int parenCounter = 0;
-                while (code[++(*codeIndex)] != ']' || parenCounter > 0) {
-                    if (code[*codeIndex] == '[') {
-                        ++parenCounter;
-                    } else if (code[*codeIndex] == ']') {
-                        --parenCounter;
-                    }
+                for (int codePtr = 0; code[codePtr] && bfProcess(code, jumps, &codePtr, &machine); ++codePtr) {
+                    ++machine.steps;
                 }
             }
-            break;
-        case ']':
-            if ((*tape)->value != 0) {
-                *codeIndex = parenthesesStack[parenthesesStackCounter] - 1;
-            } else {
-                --parenthesesStackCounter;
+            bfFlushOutput(&machine.output);
+            times[r] += (bfNanoseconds() - begin) / 1e6;
+            if (r == 0 && k == 0) {
+                result->steps = machine.steps;
+                result->checksum = hash;
+            } else if (hash != result->checksum || machine.steps != result->steps) {
+                result->consistent = false;
             }
-            break;
+            bfFreeMachine(&machine);
+        }
+        times[r] /= repeats;
+    }
+    const bool opened = input != NULL;
+    if (opened) {
+        qsort(times, runs, sizeof(double), compareTimes);
+        result->bestMilliseconds = times[0];
+        result->medianMilliseconds = runs % 2 == 1 ? times[runs / 2] : (times[runs / 2 - 1] + times[runs / 2]) / 2;
+        bfCloseInput(input);
     }
+    free(times);
+    return opened;
 }
 
-/// The length of the visible tape when printed.
-#define TAPE_LENGTH 28
+/// @brief Runs timeEngine in a child process where it can, so that the peak
+///        memory use of every engine and program is measured on its own.
+/// @param peakKilobytes where to put the peak resident set size of the runs,
+///        or 0 where it can't be measured
+/// @return true if the input file could be opened
+static bool timeEngineAlone(char *code, int *jumps, Program *program, const char *inputFileName,
+                            const Engine *engine, int runs, unsigned long long repeats,
+                            BenchResult *result, long *peakKilobytes) {
+    *peakKilobytes = 0;
+#if HAS_FORK
+    // Flush anything buffered so the child doesn't print it a second time.
+    fflush(stdout);
+    int pipeEnds[2];
+    if (pipe(pipeEnds) == 0) {
+        pid_t child = fork();
+        if (child == 0) {
+            close(pipeEnds[0]);
+            bool opened = timeEngine(code, jumps, program, inputFileName, engine, runs, repeats, result);
+            bool written = write(pipeEnds[1], result, sizeof(BenchResult)) == sizeof(BenchResult);
+            _exit(opened && written ? EXIT_SUCCESS : EXIT_FAILURE);
+        }
+        close(pipeEnds[1]);
+        if (child > 0) {
+            bool received = read(pipeEnds[0], result, sizeof(BenchResult)) == sizeof(BenchResult);
+            int status;
+            struct rusage usage;
+            bool exited = wait4(child, &status, 0, &usage) == child && WIFEXITED(status);
+            close(pipeEnds[0]);
+            if (received && exited && WEXITSTATUS(status) == EXIT_SUCCESS) {
+#if defined(__APPLE__)
+                *peakKilobytes = usage.ru_maxrss / 1024;
+#else
+                *peakKilobytes = usage.ru_maxrss;
+#endif
+                return true;
+            }
+            return false;
+        }
+        close(pipeEnds[0]);
+    }
+    // Time it in this process if there's no child to run it in.
+#endif
+    return timeEngine(code, jumps, program, inputFileName, engine, runs, repeats, result);
+}
 
-/// The distance to the middle of the stream of printed BF code.
-#define MID_DISTANCE 60
+/// @brief Finds a file named in a list relative to the directory the list is in.
+/// @param listFileName the name of the list
+/// @param fileName the name of the file in the list
+/// @return the path of the file, which has to be freed
+static char *pathFromList(const char *listFileName, const char *fileName) {
+    const char *slash = strrchr(listFileName, '/');
+    size_t directoryLength = fileName[0] == '/' || slash == NULL ? 0 : slash - listFileName + 1;
+    char *path = malloc(directoryLength + strlen(fileName) + 1);
+    memcpy(path, listFileName, directoryLength);
+    strcpy(path + directoryLength, fileName);
+    return path;
+}
 
-/// @brief Prints where the BF code is in execution, and where the tape header is on the tape.
-/// @param code the BF code
-/// @param codePtr points to the current instruction in the code being executed
-/// @param tape the current tape cell
-void printState(char *code, int codePtr, TapeCell *tape) {
-    // Useful to know where the tape was last printed from.
-    static int prevTapeStart = STARTING_TAPE_INDEX;
-
-    // The array containing the values that will be
-    static CellValue tapeValues[TAPE_LENGTH];
-
-    // Print the results so far
-    printf("\nResults: ");
-    puts(outputBuffer);
-
-    // Print the code
-    printf("Pos: %d\n", codePtr);
-    int i = codePtr < MID_DISTANCE ? 0 : codePtr - MID_DISTANCE;
-    int j = codePtr < MID_DISTANCE ? 2 * MID_DISTANCE : codePtr + MID_DISTANCE;
-    for (; i < j && code[i] && code[i] != '\n'; ++i) {
-        putchar(code[i]);
-    }
-    putchar('\n');
-    for (i = 0; i <= (codePtr < MID_DISTANCE ? codePtr : MID_DISTANCE); ++i) {
-        putchar(' ');
-    }
-    printf("^\n");
-
-    // Update the prev tape start if necessary.
-    if (theTapeIndex < prevTapeStart) {
-        prevTapeStart = theTapeIndex;
-    } else if (theTapeIndex >= prevTapeStart + TAPE_LENGTH - 1) {
-        prevTapeStart = theTapeIndex - TAPE_LENGTH + 1;
-    }
-
-    // Fill in the tapeValues array with teh values to be printed.
-    TapeCell *cell = tape;
-    const int valuesIndex = theTapeIndex - prevTapeStart;
-    for (i = valuesIndex; i >= 0; --i) {
-        if (cell != NULL) {
-            tapeValues[i] = cell->value;
-            cell = cell->left;
-        } else {
-            tapeValues[i] = 0;
-        }
+/// @brief Times every engine, and the legacy bfProcess() path, on every program
+///        in a benchmark corpus, and prints the results as tab separated values
+///        with a line per program and engine, so runs on different commits can
+///        be diffed. The programs are listed like in a batch list, with paths
+///        relative to the list, and each line can end with the number of times
+///        the engines go through the program in each timed run.
+/// @param corpusFileName the list of benchmark programs
+/// @param runs the number of times each engine runs each program
+/// @return EXIT_SUCCESS if every engine gave the same output as bfProcess() on
+///         every program, otherwise EXIT_FAILURE
+static int runBench(const char *corpusFileName, int runs) {
+    BatchJob *jobs = NULL;
+    int jobCount = 0;
+    bool agreed = readBatchList(corpusFileName, &jobs, &jobCount);
+
+    if (agreed) {
+        printf("program\tengine\truns\trepeats\tsteps\tbest_ms\tmedian_ms\tsteps_per_sec\tpeak_rss_kib\tchecksum\n");
     }
-    cell = tape->right;
-    for (i = valuesIndex + 1; i < TAPE_LENGTH; ++i) {
-        if (cell != NULL) {
-            tapeValues[i] = cell->value;
-            cell = cell->right;
+    for (int i = 0; i < jobCount && agreed; ++i) {
+        char *codeFileName = pathFromList(corpusFileName, jobs[i].codeFileName);
+        char *inputFileName = pathFromList(corpusFileName, jobs[i].inputFileName);
+        FileContents codeFile;
+        char *code = NULL;
+        int *jumps = NULL;
+        Program program = {0};
+        if (!bfLoadFile(codeFileName, &codeFile)) {
+            printf("There was an error opening %s\n", codeFileName);
+            agreed = false;
         } else {
-            tapeValues[i] = 0;
+            // bfProcess() goes through the code a character at a time, so it
+            // only gets the commands, which leaves its steps counting nothing else.
+            code = malloc(codeFile.size + 1);
+            size_t length = 0;
+            for (size_t c = 0; c < codeFile.size; ++c) {
+                if (codeFile.data[c] != '\0' && strchr("+-<>.,[]", codeFile.data[c]) != NULL) {
+                    code[length++] = codeFile.data[c];
+                }
+            }
+            code[length] = '\0';
+            bfUnloadFile(&codeFile);
+            jumps = bfMatchBrackets(code);
+            if (jumps == NULL || !bfCompile(code, &program, true)) {
+                fprintf(stderr, "The brackets in %s are unbalanced\n", codeFileName);
+                agreed = false;
+            }
         }
+
+        unsigned long long referenceChecksum = 0;
+        for (int e = -1; e < bfEngineCount && agreed; ++e) {
+            const Engine *engine = e < 0 ? NULL : &bfEngines[e];
+            if (!HAS_JIT && engine != NULL && strcmp(engine->name, "jit") == 0) {
+                continue;
+            }
+            // The legacy path takes long enough to time on every program as it is.
+            const unsigned long long repeats = engine != NULL ? jobs[i].repeats : 1;
+            BenchResult result;
+            long peakKilobytes;
+            if (!timeEngineAlone(code, jumps, &program, inputFileName, engine, runs, repeats, &result, &peakKilobytes)) {
+                printf("There was an error opening %s\n", inputFileName);
+                agreed = false;
+                break;
+            }
+            const char *engineName = engine != NULL ? engine->name : PROCESS_ENGINE_NAME;
+            printf("%s\t%s\t%d\t%llu\t%llu\t%.3f\t%.3f\t%.0f\t%ld\t%016llx\n",
+                   jobs[i].codeFileName, engineName, runs, repeats, result.steps, result.bestMilliseconds,
+                   result.medianMilliseconds, result.steps / (result.bestMilliseconds / 1e3),
+                   peakKilobytes, result.checksum);
+            if (e < 0) {
+                referenceChecksum = result.checksum;
+            }
+            if (!result.consistent || result.checksum != referenceChecksum) {
+                fprintf(stderr, "%s gave different output on %s\n", engineName, jobs[i].codeFileName);
+                agreed = false;
+            }
+        }
+
+        free(program.instructions);
+        free(jumps);
+        free(code);
+        free(codeFileName);
+        free(inputFileName);
     }
-  
-    // Print the tape pointer and the tape.
-    for (i = 0; i <= valuesIndex; ++i) {
-        printf("    ");
-    }
-    printf(" v\n... ");
-    for (i = 0; i < TAPE_LENGTH; ++i) {
-        printf("%.03d ", tapeValues[i]);
+
+    for (int i = 0; i < jobCount; ++i) {
+        free((char *) jobs[i].codeFileName);
+        free((char *) jobs[i].inputFileName);
     }
-    printf("...\n");
+    free(jobs);
+    return agreed ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+/// The longest sequences of instructions --dump-ngrams counts.
+#define MAX_NGRAM_LENGTH 3
+
+/// The number of most common sequences of each length --dump-ngrams lists.
+#define NGRAM_REPORT_LENGTH 20
 
-    // Prompt the user for the next debug command.
-    printf("CMD: ");
+/// The number of different operations, for counting sequences of them.
+#define OP_COUNT (OP_END + 1)
+
+/// @brief How many times a sequence of operations ran, for --dump-ngrams.
+typedef struct {
+    OpCode ops[MAX_NGRAM_LENGTH];
+    unsigned long long count;
+} Ngram;
+
+/// @brief Orders sequences from the most runs to the least, for qsort.
+static int compareNgrams(const void *a, const void *b) {
+    unsigned long long x = ((const Ngram *) a)->count;
+    unsigned long long y = ((const Ngram *) b)->count;
+    return (x < y) - (x > y);
 }
 
-/// Processes the code until a certain condition is satisfied.
-#define PROCESS_UNTIL(condition)                                              \
-    do {                                                                      \
-        process(code, &codePtr, &tape, input);                                \
-    } while (++codePtr < CODE_SIZE && code[codePtr] && (condition));          \
-    --codePtr
+/// @brief Runs every program in a benchmark corpus with the profiling engine
+///        and prints the sequences of two and three operations that ran the
+///        most, as tab separated values, which is what the superinstructions
+///        are picked from. A sequence only counts within a straight run of
+///        instructions, where every instruction but the last always goes on
+///        to the next one, so each one runs as often as its first instruction.
+///        Superinstructions count as the operations they run.
+/// @param corpusFileName the list of benchmark programs
+/// @return EXIT_SUCCESS if every program could be run, otherwise EXIT_FAILURE
+static int dumpNgrams(const char *corpusFileName) {
+    BatchJob *jobs = NULL;
+    int jobCount = 0;
+    bool valid = readBatchList(corpusFileName, &jobs, &jobCount);
+    // The runs of every sequence, by its operations as digits in base OP_COUNT.
+    int ngramCount = OP_COUNT * OP_COUNT * OP_COUNT;
+    unsigned long long *counts[MAX_NGRAM_LENGTH + 1] = {NULL};
+    for (int length = 2; length <= MAX_NGRAM_LENGTH; ++length) {
+        counts[length] = calloc(ngramCount, sizeof(unsigned long long));
+    }
+    unsigned long long totalSteps = 0;
+
+    for (int i = 0; i < jobCount && valid; ++i) {
+        char *codeFileName = pathFromList(corpusFileName, jobs[i].codeFileName);
+        char *inputFileName = pathFromList(corpusFileName, jobs[i].inputFileName);
+        FileContents codeFile;
+        Input *input = NULL;
+        Program program = {0};
+        if (!bfLoadFile(codeFileName, &codeFile)) {
+            printf("There was an error opening %s\n", codeFileName);
+            valid = false;
+        } else {
+            if (!bfCompile(codeFile.data, &program, true)) {
+                fprintf(stderr, "The brackets in %s are unbalanced\n", codeFileName);
+                valid = false;
+            } else if ((input = bfOpenInput(inputFileName, false)) == NULL) {
+                printf("There was an error opening %s\n", inputFileName);
+                valid = false;
+            }
+            bfUnloadFile(&codeFile);
+        }
+
+        if (valid) {
+            BFMachine machine = bfNewMachine(&program, input, false);
+            machine.profile = &profile;
+            profile.counts = calloc(program.count, sizeof(unsigned long long));
+            bfRunProfiled(&machine);
+            totalSteps += machine.steps;
+            for (int start = 0; start < program.count; ++start) {
+                int key = 0;
+                for (int length = 1; length <= MAX_NGRAM_LENGTH && start + length <= program.count; ++length) {
+                    OpCode op = bfBaseOp(program.instructions[start + length - 1].op);
+                    key = key * OP_COUNT + op;
+                    if (length > 1) {
+                        counts[length][key] += profile.counts[start];
+                    }
+                    if (op == OP_JZ || op == OP_JNZ || op == OP_END) {
+                        break;
+                    }
+                }
+            }
+            free(profile.counts);
+            bfFreeMachine(&machine);
+            bfCloseInput(input);
+        }
+        free(program.instructions);
+        free(codeFileName);
+        free(inputFileName);
+    }
+
+    if (valid) {
+        Ngram *ngrams = malloc(ngramCount * sizeof(Ngram));
+        printf("ngram\tcount\tpercent\n");
+        for (int length = 2; length <= MAX_NGRAM_LENGTH; ++length) {
+            for (int key = 0; key < ngramCount; ++key) {
+                ngrams[key].count = counts[length][key];
+                for (int k = length - 1, rest = key; k >= 0; --k, rest /= OP_COUNT) {
+                    ngrams[key].ops[k] = rest % OP_COUNT;
+                }
+            }
+            qsort(ngrams, ngramCount, sizeof(Ngram), compareNgrams);
+            for (int rank = 0; rank < NGRAM_REPORT_LENGTH && ngrams[rank].count > 0; ++rank) {
+                for (int k = 0; k < length; ++k) {
+                    printf("%s%s", k > 0 ? " " : "", bfOpNames[ngrams[rank].ops[k]]);
+                }
+                printf("\t%llu\t%.2f%%\n", ngrams[rank].count, ngrams[rank].count * 100.0 / totalSteps);
+            }
+        }
+        free(ngrams);
+    }
 
-/// @brief Reads a file into a given buffer.
-/// @param fileName the name of the file to read
-/// @param buffer the buffer to read into
-/// @return true if succesful
-static bool _readFile(char *fileName, char *buffer) {
-    bool result = true;
-    FILE *filePtr = fopen(fileName, "r");
-    if (!fgets(buffer, CODE_SIZE, filePtr)) {
-        result = false;
+    for (int length = 2; length <= MAX_NGRAM_LENGTH; ++length) {
+        free(counts[length]);
     }
-    if (filePtr) {
-        fclose(filePtr);
+    for (int i = 0; i < jobCount; ++i) {
+        free((char *) jobs[i].codeFileName);
+        free((char *) jobs[i].inputFileName);
     }
-    return result;
+    free(jobs);
+    return valid ? EXIT_SUCCESS : EXIT_FAILURE;
 }
 
-/// Wrapper macro around the readFile function that gives an error mesage
-/// and crashes the program if there was an error.
-#define READ_FILE(fileName, bufferName)                                       \
-    if (!_readFile((fileName), (char *) (bufferName))) {                      \
-        printf("There was an error opening %s\n", (fileName));                \
-        return EXIT_FAILURE;                                                  \
+/// @brief Reads a single option from the cmd line into the options.
+/// @param arg the cmd line arg, which starts with "--"
+/// @param options the options to update
+/// @return true if the option is valid
+static bool parseOption(char *arg, Options *options) {
+    if (strncmp(arg, "--engine=", 9) == 0) {
+        options->engine = bfFindEngine(arg + 9);
+        return options->engine != NULL;
+    }
+    if (strcmp(arg, "--bench-scan") == 0) {
+        options->benchScan = true;
+        return true;
+    }
+    if (strcmp(arg, "--compare") == 0) {
+        options->compare = true;
+        return true;
+    }
+    if (strncmp(arg, "--emit-c=", 9) == 0) {
+        options->emitC = arg + 9;
+        return *options->emitC != '\0';
+    }
+    if (strncmp(arg, "--output=", 9) == 0) {
+        options->outputFileName = arg + 9;
+        return *options->outputFileName != '\0';
+    }
+    if (strcmp(arg, "--raw-output") == 0) {
+        options->rawOutput = true;
+        return true;
+    }
+    if (strcmp(arg, "--raw-input") == 0) {
+        options->rawInput = true;
+        return true;
+    }
+    if (strcmp(arg, "--profile") == 0) {
+        options->profile = true;
+        return true;
+    }
+    if (strcmp(arg, "--virtual-tape") == 0) {
+        options->virtualTape = true;
+        return true;
+    }
+    if (strcmp(arg, "--bench-tape") == 0) {
+        options->benchTape = true;
+        return true;
+    }
+    if (strncmp(arg, "--watch=", 8) == 0) {
+        return bfAddWatch(&watches, arg + 8);
+    }
+    if (strncmp(arg, "--snapshot-interval=", 20) == 0) {
+        return parseCount(arg + 20, &options->snapshotInterval);
+    }
+    if (strncmp(arg, "--snapshot-memory=", 18) == 0) {
+        return parseCount(arg + 18, &options->snapshotMemory) && options->snapshotMemory <= ((size_t) -1 >> 20);
+    }
+    if (strcmp(arg, "--batch") == 0) {
+        options->batch = true;
+        return true;
+    }
+    if (strncmp(arg, "--batch-list=", 13) == 0) {
+        options->batchList = arg + 13;
+        return *options->batchList != '\0';
+    }
+    if (strncmp(arg, "--jobs=", 7) == 0) {
+        return parseCount(arg + 7, &options->jobs) && options->jobs <= INT_MAX;
     }
+    if (strncmp(arg, "--max-steps=", 12) == 0) {
+        return parseCount(arg + 12, &options->maxSteps);
+    }
+    if (strncmp(arg, "--timeout=", 10) == 0) {
+        return parseCount(arg + 10, &options->timeout);
+    }
+    if (strcmp(arg, "--bench") == 0) {
+        options->bench = DEFAULT_BENCH_CORPUS;
+        return true;
+    }
+    if (strncmp(arg, "--bench=", 8) == 0) {
+        options->bench = arg + 8;
+        return *options->bench != '\0';
+    }
+    if (strncmp(arg, "--bench-runs=", 13) == 0) {
+        return parseCount(arg + 13, &options->benchRuns) && options->benchRuns > 0 && options->benchRuns <= INT_MAX;
+    }
+    if (strcmp(arg, "--dump-ngrams") == 0) {
+        options->dumpNgrams = DEFAULT_BENCH_CORPUS;
+        return true;
+    }
+    if (strncmp(arg, "--dump-ngrams=", 14) == 0) {
+        options->dumpNgrams = arg + 14;
+        return *options->dumpNgrams != '\0';
+    }
+    if (strncmp(arg, "--trace=", 8) == 0) {
+        options->trace = arg + 8;
+        return *options->trace != '\0';
+    }
+    return false;
+}
 
 #define code_file_arg argv[1]
 #define input_file_arg argv[2]
 #define breakpoint_arg argv[3]
 
+/// How to run the interpreter.
+#define USAGE \
+    "Usage: ./interpreter [--engine=threaded|switch|jit|tiered] [--compare] [--profile] [--virtual-tape]\n" \
+    "                     [--output=file] [--raw-output] [--raw-input] [--watch=cell[:value]]...\n" \
+    "                     [--snapshot-interval=steps] [--snapshot-memory=MiB]\n" \
+    "                     [--max-steps=steps] [--timeout=ms] [--trace=trace_file]\n" \
+    "                     code_file input_file [breakpoint]\n" \
+    "       ./interpreter --batch [--jobs=threads] code_file input_file...\n" \
+    "       ./interpreter --batch-list=list_file [--jobs=threads]\n" \
+    "       ./interpreter --emit-c=output.c code_file\n" \
+    "       ./interpreter --bench-scan\n" \
+    "       ./interpreter --bench-tape\n" \
+    "       ./interpreter --bench[=corpus_file] [--bench-runs=runs]\n" \
+    "       ./interpreter --dump-ngrams[=corpus_file]\n"
+
 /// @brief The main function :)
 /// @param argc number of cmd line args (which must be at most 2)
 /// @param argv cmd lines args
@@ -275,44 +1592,344 @@ int main(int argc, char *argv[]) {
     // Get cmd line args (a potential breakpoint that if reached will
     // make the interpreter go into visual mode displaying the code
     // and the tape).
-    int breakpoint = CODE_SIZE;
-    char code[CODE_SIZE];
-    CellValue input[INPUT_SIZE];
+    int breakpoint = INT_MAX;
+    FileContents codeFile;
+
+    // Pull the options out of the cmd line args, leaving the rest in order.
+    Options options = {NULL, false, false, NULL, NULL, false, false, false, false, false,
+                       DEFAULT_SNAPSHOT_INTERVAL, DEFAULT_SNAPSHOT_MEMORY, false, NULL, 0, ULLONG_MAX, 0,
+                       NULL, DEFAULT_BENCH_RUNS, NULL, NULL};
+    int positionalCount = 1;
+    for (int i = 1; i < argc; ++i) {
+        if (strncmp(argv[i], "--", 2) != 0) {
+            argv[positionalCount++] = argv[i];
+        } else if (!parseOption(argv[i], &options)) {
+            fprintf(stderr, "Invalid option %s\n", argv[i]);
+            return EXIT_FAILURE;
+        }
+    }
+    argc = positionalCount;
+
+    // Profiling runs on an engine of its own, so no other one can be picked for it.
+    if (options.profile && options.engine != NULL) {
+        fprintf(stderr, "The code can't be profiled on another engine\n");
+        return EXIT_FAILURE;
+    }
+    if (options.engine == NULL) {
+        options.engine = &bfEngines[0];
+    }
+
+    if (options.benchScan) {
+        return bfBenchScan();
+    }
+    if (options.benchTape) {
+        return bfBenchTape();
+    }
+    if (options.bench != NULL) {
+        return runBench(options.bench, (int) options.benchRuns);
+    }
+    if (options.dumpNgrams != NULL) {
+        return dumpNgrams(options.dumpNgrams);
+    }
+    if (options.batch || options.batchList != NULL) {
+        // Either one code file with every input file after it, or a list of jobs.
+        BatchJob *jobs = NULL;
+        int jobCount = 0;
+        bool valid = options.batchList == NULL ? argc >= 3 : argc == 1;
+        if (!valid) {
+            fprintf(stderr, USAGE);
+        } else if (options.batchList != NULL) {
+            valid = readBatchList(options.batchList, &jobs, &jobCount);
+        } else {
+            jobCount = argc - 2;
+            jobs = malloc(jobCount * sizeof(BatchJob));
+            for (int i = 0; i < jobCount; ++i) {
+                jobs[i] = (BatchJob) {.codeFileName = strdup(code_file_arg), .inputFileName = strdup(argv[i + 2])};
+            }
+        }
+        // Every job runs at once, so none of them can have stdin to itself.
+        for (int i = 0; i < jobCount && valid; ++i) {
+            if (strcmp(jobs[i].inputFileName, "-") == 0) {
+                fprintf(stderr, "A batch can't read its input from stdin\n");
+                valid = false;
+            }
+        }
+        // The files are found relative to the list, like in a benchmark corpus.
+        for (int i = 0; i < jobCount && valid && options.batchList != NULL; ++i) {
+            char *codeFileName = pathFromList(options.batchList, jobs[i].codeFileName);
+            char *inputFileName = pathFromList(options.batchList, jobs[i].inputFileName);
+            free((char *) jobs[i].codeFileName);
+            free((char *) jobs[i].inputFileName);
+            jobs[i].codeFileName = codeFileName;
+            jobs[i].inputFileName = inputFileName;
+        }
+        int result = valid && jobCount > 0 ?
+            runBatch(jobs, jobCount, &options) :
+            EXIT_FAILURE;
+        for (int i = 0; i < jobCount; ++i) {
+            free((char *) jobs[i].codeFileName);
+            free((char *) jobs[i].inputFileName);
+        }
+        free(jobs);
+        return result;
+    }
+    if (options.emitC != NULL) {
+        if (argc != 2) {
+            fprintf(stderr, USAGE);
+            return EXIT_FAILURE;
+        }
+        READ_FILE(code_file_arg, codeFile);
+        Program program = {0};
+        bool compiled = bfCompile(codeFile.data, &program, true);
+        bfUnloadFile(&codeFile);
+        if (!compiled) {
+            fprintf(stderr, "The brackets in %s are unbalanced\n", code_file_arg);
+            free(program.instructions);
+            return EXIT_FAILURE;
+        }
+        FILE *file = fopen(options.emitC, "w");
+        if (file == NULL) {
+            printf("There was an error opening %s\n", options.emitC);
+            free(program.instructions);
+            return EXIT_FAILURE;
+        }
+        emitC(&program, code_file_arg, file);
+        fclose(file);
+        free(program.instructions);
+        return EXIT_SUCCESS;
+    }
 
     switch (argc) {
         case 4:
             breakpoint = atoi(breakpoint_arg);
         case 3:
-            READ_FILE(code_file_arg, code);
-            READ_FILE(input_file_arg, input);
+            READ_FILE(code_file_arg, codeFile);
             break;
         default:
-            fprintf(stderr, "Usage: ./interpreter code_file input_file [breakpoint]\n");
+            fprintf(stderr, USAGE);
+            return EXIT_FAILURE;
+    }
+    char *code = codeFile.data;
+
+    // A breakpoint or a watchpoint starts the visual mode, which reads its
+    // commands from stdin, so the input can't come from there too.
+    const bool visual = argc == 4 || watches.count > 0;
+    if (visual && strcmp(input_file_arg, "-") == 0) {
+        fprintf(stderr, "The input can't come from stdin in visual mode\n");
+        bfUnloadFile(&codeFile);
+        return EXIT_FAILURE;
+    }
+    if (visual && (options.maxSteps != ULLONG_MAX || options.timeout > 0)) {
+        fprintf(stderr, "The step and time limits can't be used in visual mode\n");
+        bfUnloadFile(&codeFile);
+        return EXIT_FAILURE;
+    }
+    if (options.trace != NULL && (visual || options.profile || options.timeout > 0)) {
+        fprintf(stderr, "A trace can't be recorded in visual mode, while profiling or with a time limit\n");
+        bfUnloadFile(&codeFile);
+        return EXIT_FAILURE;
+    }
+    Input *input = bfOpenInput(input_file_arg, options.rawInput);
+    if (input == NULL) {
+        printf("There was an error opening %s\n", input_file_arg);
+        bfUnloadFile(&codeFile);
+        return EXIT_FAILURE;
+    }
+
+    // Match up the brackets once so that jumps never have to search the code.
+    int *jumps = bfMatchBrackets(code);
+    if (jumps == NULL) {
+        fprintf(stderr, "The brackets in %s are unbalanced\n", code_file_arg);
+        bfUnloadFile(&codeFile);
+        bfCloseInput(input);
+        return EXIT_FAILURE;
+    }
+
+    // The results are printed between "Results: " and "Done!" unless they
+    // are raw bytes or are going to a file of their own.
+    FILE *destination = stdout;
+    if (options.outputFileName != NULL) {
+        destination = fopen(options.outputFileName, "wb");
+        if (destination == NULL) {
+            printf("There was an error opening %s\n", options.outputFileName);
+            free(jumps);
+            bfUnloadFile(&codeFile);
+            bfCloseInput(input);
+            return EXIT_FAILURE;
+        }
+    }
+    const bool framed = destination == stdout && !options.rawOutput;
+
+    TraceWriter *trace = NULL;
+    if (options.trace != NULL) {
+        trace = bfOpenTraceWriter(options.trace, options.rawOutput);
+        if (trace == NULL) {
+            printf("There was an error opening %s\n", options.trace);
+            if (destination != stdout) {
+                fclose(destination);
+            }
+            free(jumps);
+            bfUnloadFile(&codeFile);
+            bfCloseInput(input);
             return EXIT_FAILURE;
+        }
     }
 
     char buffer[BUFFER_SIZE];
-    TapeCell *tape = newTapeCell();
+    Program program = {0};
+    // The part of the tape shown, which follows the tape head from one print to the next.
+    TapeView view = {0};
+    BFMachine machine = bfNewMachine(&program, input, options.virtualTape);
+    if (options.virtualTape && !machine.tape.isVirtual) {
+#if HAS_VIRTUAL_TAPE
+        fprintf(stderr, "The virtual tape couldn't be reserved, so the normal tape is being used\n");
+#else
+        fprintf(stderr, "Virtual tapes aren't supported on this platform, so the normal tape is being used\n");
+#endif
+    }
+    machine.output.raw = options.rawOutput;
+    machine.profile = &profile;
+    machine.watches = &watches;
+
+    // Without a breakpoint or a watchpoint there is no visual mode, so the
+    // whole code can be compiled and executed at once, streaming out the
+    // results (unless they have to be kept to compare with the reference).
+    if (!visual) {
+        // A trace records the steps of the code compiled like in the visual
+        // mode, so that replaying it stops at all of the same places.
+        bfCompile(code, &program, trace == NULL);
+        if (!options.compare) {
+            machine.output.write = bfWriteToFile;
+            machine.output.context = destination;
+        }
+        if (framed) {
+            printf("Results: ");
+        }
+        machine.stepLimit = options.maxSteps;
+        if (options.timeout > 0) {
+            machine.deadline = bfNanoseconds() + options.timeout * 1e6;
+        }
+        if (trace != NULL) {
+            machine.trace = trace;
+            bfRunTraced(&machine);
+        } else if (options.profile) {
+            profile.counts = calloc(program.count, sizeof(unsigned long long));
+            profile.lowestTapeIndex = machine.tape.head;
+            profile.highestTapeIndex = machine.tape.head;
+            bfRunProfiled(&machine);
+        } else {
+            bfRunMachine(&machine, options.engine);
+        }
+
+        // Code stopped part way can't be compared, since the reference would
+        // run it all the way.
+        const bool stopped = machine.stopReason != STOP_END;
+        bool agreed = stopped || !options.compare || compareWithReference(code, jumps, &machine);
+        machine.output.write = bfWriteToFile;
+        machine.output.context = destination;
+        bfFlushOutput(&machine.output);
+        int result = agreed ? EXIT_SUCCESS : EXIT_FAILURE;
+        if (trace != NULL && !bfCloseTraceWriter(trace)) {
+            fprintf(stderr, "There was an error writing the trace to %s\n", options.trace);
+            result = EXIT_FAILURE;
+        }
+        if (stopped && (machine.stopReason == STOP_TAPE || machine.stopReason == STOP_MEMORY)) {
+            // It stopped partway through an instruction, so there's no state to show.
+            if (framed) {
+                putchar('\n');
+            }
+            printf("Stopped: %s\n", describeStop(machine.stopReason));
+            result = EXIT_FAILURE;
+        } else if (stopped) {
+            // Show where the code was when it stopped. An OP_JNZ has already
+            // run when it stops, while I/O hasn't yet, and nothing has when
+            // tracing, which stops before the step past the limit.
+            Instruction *instruction = &program.instructions[machine.stoppedAt];
+            if (framed) {
+                putchar('\n');
+            }
+            if (machine.stopReason == STOP_STEP_LIMIT) {
+                printf("Stopped: ran past the step limit of %llu\n", options.maxSteps);
+                result = EXIT_STEP_LIMIT;
+            } else {
+                printf("Stopped: ran past the time limit of %llu ms\n", options.timeout);
+                result = EXIT_TIME_LIMIT;
+            }
+            const bool ran = instruction->op == OP_JNZ && trace == NULL;
+            bfPrintState(code, ran ? instruction->pos : instruction->pos - 1, &machine, &view);
+        } else if (framed) {
+            printf("\nDone!\n");
+        }
+        if (options.compare && !stopped) {
+            printf("The %s engine %s the reference interpreter\n",
+                   trace != NULL ? "tracing" : options.profile ? "profiling" : options.engine->name, agreed ? "matches" : "does NOT match");
+        }
+        if (options.profile) {
+            printProfile(stderr, code, &program);
+            free(profile.counts);
+        }
+        free(program.instructions);
+        free(jumps);
+        bfFreeMachine(&machine);
+        if (destination != stdout) {
+            fclose(destination);
+        }
+        bfUnloadFile(&codeFile);
+        bfCloseInput(input);
+        return result;
+    }
+
+    // The visual mode runs the code compiled with an instruction for every BF
+    // character, and stops it by patching traps into the instructions it
+    // should stop at, so it runs at full speed in between.
+    bfCompile(code, &program, false);
+    Traps traps = {calloc(program.count, sizeof(OpCode)), NULL, 0, 0};
 
-    // Process the code up until the breakpoint.
-    int codePtr = 0;
-    PROCESS_UNTIL(codePtr <= breakpoint);
+    // Snapshots taken every so often on the way let the visual mode go back
+    // to any step by replaying it from the last snapshot before it.
+    snapshots.interval = options.snapshotInterval;
+    snapshots.memoryBudget = (size_t) options.snapshotMemory << 20;
+    takeSnapshot(&machine, 0);
+
+    // Process the code up until the breakpoint (or a watchpoint).
+    int next = 0;
+    if (program.instructions[next].pos <= breakpoint) {
+        trapPastPosition(&program, &traps, breakpoint);
+        next = runToTraps(&machine, &traps, next, ULLONG_MAX);
+    }
 
     // If the code is not done being processed, then print the current state.
-    bool finish = !code[codePtr + 1];
+    // The position shown is always the one just before the next instruction.
+    bool finish = program.instructions[next].op == OP_END;
     if (!finish) {
-        printState(code, codePtr, tape);
+        bfPrintState(code, program.instructions[next].pos - 1, &machine, &view);
+        printf("CMD: ");
     }
 
     // Main "debug" loop for the visual mode of the interpreter.
     // Inputing a valid BF instruction will cause the code to execute up
     // until the first instruction seen of that kind (without executing it).
+    // Inputing a lowercase 'e' will cause the code to execute up until the
+    // end of the loop it is in (without executing its ']').
+    // Inputing a lowercase 'o' will step over the loop that starts at the next
+    // instruction, running all of it, or step once if there isn't one.
+    // Inputing a lowercase 'w' followed by a tape index (and optionally ':' and
+    // a value) will add a watchpoint that stops the code right after that
+    // cell changes (to that value), and a lone 'w' will remove them all.
+    // Inputing a lowercase 'b' will go back a step, or as many steps as the
+    // number after it says, and inputing a lowercase 'g' followed by a step
+    // will go to that step (forward or back).
     // Inputing a lowercase 'f' will cause the interpreter to exit visual mode
     // and finish interpreting the rest of the code.
     // Inputing a number greater than the currently displayed position (Pos: #)
     // will set that number as the new breakpoint and execute up until that breakpoint.
-    while (++codePtr < CODE_SIZE && code[codePtr]) {
-        fgets(buffer, BUFFER_SIZE, stdin);
+    while (program.instructions[next].op != OP_END) {
+        if (fgets(buffer, BUFFER_SIZE, stdin) == NULL) {
+            // Nothing more can be asked for, so finish like 'f' does.
+            break;
+        }
+        int loop;
+        unsigned long long count;
         switch (buffer[0]) {
             case '+':
             case '-':
@@ -322,36 +1939,101 @@ int main(int argc, char *argv[]) {
             case ']':
             case '.':
             case ',':
-                PROCESS_UNTIL(code[codePtr] != buffer[0]);
+                for (int i = 0; i < program.count - 1; ++i) {
+                    if (code[program.instructions[i].pos] == buffer[0]) {
+                        bfSetTrap(&program, &traps, i);
+                    }
+                }
+                next = runToTraps(&machine, &traps, next, ULLONG_MAX);
+                break;
+            case 'e':
+                loop = enclosingLoop(&program, &traps, next);
+                if (loop >= 0) {
+                    bfSetTrap(&program, &traps, program.instructions[loop].arg - 1);
+                } else {
+                    trapNextStep(&program, &traps, next);
+                }
+                next = runToTraps(&machine, &traps, next, ULLONG_MAX);
+                break;
+            case 'o':
+                if (program.instructions[next].op == OP_JZ) {
+                    bfSetTrap(&program, &traps, program.instructions[next].arg);
+                } else {
+                    trapNextStep(&program, &traps, next);
+                }
+                next = runToTraps(&machine, &traps, next, ULLONG_MAX);
+                break;
+            case 'w':
+                watches.hit = -1;
+                if (buffer[1] == '\n' || buffer[1] == '\0') {
+                    watches.count = 0;
+                } else if (!bfAddWatch(&watches, buffer + 1)) {
+                    printf("Invalid watchpoint, expected w cell or w cell:value\n");
+                }
+                break;
+            case 'b':
+                count = 1;
+                if (buffer[1] != '\n' && buffer[1] != '\0' && !parseCount(buffer + 1, &count)) {
+                    printf("Invalid step count, expected b or b count\n");
+                    break;
+                }
+                next = goToStep(&machine, &traps, next, count < machine.steps ? machine.steps - count : 0);
+                break;
+            case 'g':
+                if (!parseCount(buffer + 1, &count)) {
+                    printf("Invalid step, expected g step\n");
+                    break;
+                }
+                next = goToStep(&machine, &traps, next, count);
                 break;
             case 'f':
                 finish = true;
                 break;
             default:
-                process(code, &codePtr, &tape, input);
+                trapNextStep(&program, &traps, next);
+                next = runToTraps(&machine, &traps, next, ULLONG_MAX);
                 if (isdigit(buffer[0]) && buffer[0] != '0') {
                     breakpoint = atoi(buffer);
-                    if (breakpoint > codePtr + 1) {
-                        ++codePtr;
-                        PROCESS_UNTIL(codePtr <= breakpoint);
+                    if (breakpoint > program.instructions[next].pos) {
+                        trapPastPosition(&program, &traps, breakpoint);
+                        next = runToTraps(&machine, &traps, next, ULLONG_MAX);
                     }
                 }
         }
         if (finish) break;
-        printState(code, codePtr, tape);
+        bfPrintState(code, program.instructions[next].pos - 1, &machine, &view);
+        printf("CMD: ");
     }
 
-    // Finish interpreting the code
-    while (++codePtr < CODE_SIZE && code[codePtr]) {
-        process(code, &codePtr, &tape, input);
-    }
+    // Finish interpreting the code, without stopping at the watchpoints or
+    // taking any more snapshots.
+    watches.count = 0;
+    snapshots.interval = 0;
+    runToTraps(&machine, &traps, next, ULLONG_MAX);
+    freeSnapshots();
+    free(program.instructions);
+    free(traps.savedOps);
+    free(traps.indices);
+    free(watches.list);
 
-    printf("Results: ");
-    puts(outputBuffer);
-    printf("Done!\n");
+    if (framed) {
+        printf("Results: ");
+    }
+    machine.output.write = bfWriteToFile;
+    machine.output.context = destination;
+    bfFlushOutput(&machine.output);
+    if (framed) {
+        printf("\nDone!\n");
+    }
 
-    // Free the tape
-    freeTape(tape);
+    // Free the jump table, the machine, and the files
+    free(jumps);
+    bfFreeMachine(&machine);
+    if (destination != stdout) {
+        fclose(destination);
+    }
+    bfUnloadFile(&codeFile);
+    bfCloseInput(input);
 
     return EXIT_SUCCESS;
 }
@@ -0,0 +1,102 @@
+// Replays a trace recorded with ./interpreter --trace=trace_file, showing the
+// code and the tape at any of its steps the same way the visual mode does,
+// without running the code again.
+
+#include <limits.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "bf.h"
+
+#define USAGE "Usage: ./replay code_file trace_file [step]...\n"
+
+/// @brief Reads a step number from the cmd line.
+/// @param text the cmd line arg
+/// @param step where to put the step
+/// @return true if the arg is a number
+static bool parseStep(const char *text, unsigned long long *step) {
+    char *end;
+    if (*text < '0' || *text > '9') {
+        return false;
+    }
+    *step = strtoull(text, &end, 10);
+    return *end == '\0';
+}
+
+/// @brief Prints the state of the code and the tape at every step given on
+///        the cmd line, in order, or at the end of the trace if there are none.
+/// @param argc number of cmd line args
+/// @param argv cmd line args: the code file, the trace file and the steps
+/// @return EXIT_SUCCESS if the whole trace could be read, otherwise EXIT_FAILURE
+int main(int argc, char *argv[]) {
+    if (argc < 3) {
+        fprintf(stderr, USAGE);
+        return EXIT_FAILURE;
+    }
+    for (int i = 3; i < argc; ++i) {
+        unsigned long long step;
+        if (!parseStep(argv[i], &step)) {
+            fprintf(stderr, "Invalid step %s\n", argv[i]);
+            return EXIT_FAILURE;
+        }
+    }
+    FileContents codeFile;
+    if (!bfLoadFile(argv[1], &codeFile)) {
+        printf("There was an error opening %s\n", argv[1]);
+        return EXIT_FAILURE;
+    }
+
+    // The machine only ever gets the tape and output of the trace, so it has no program.
+    TraceReader *trace = NULL;
+    BFMachine machine = {0};
+    TapeView view = {0};
+    int result = EXIT_SUCCESS;
+    for (int i = argc == 3 ? 2 : 3; i < argc; ++i) {
+        unsigned long long step = ULLONG_MAX;
+        if (i > 2) {
+            parseStep(argv[i], &step);
+        }
+
+        // Going back to an earlier step replays the trace from the start.
+        if (trace == NULL || step < machine.steps) {
+            if (trace != NULL) {
+                bfCloseTraceReader(trace);
+                bfFreeMachine(&machine);
+            }
+            trace = bfOpenTraceReader(argv[2]);
+            if (trace == NULL) {
+                printf("%s isn't a trace that can be read\n", argv[2]);
+                result = EXIT_FAILURE;
+                break;
+            }
+            machine = bfNewMachine(NULL, NULL, false);
+            machine.output.raw = trace->rawOutput;
+        }
+
+        const int pos = bfReplayTrace(trace, &machine, step);
+        if (pos < 0 && machine.stopReason != STOP_END) {
+            printf("Stopped replaying step %llu: %s\n", machine.steps,
+                   machine.stopReason == STOP_TAPE ? "the tape can't grow any further" : "out of memory for the output");
+            result = EXIT_FAILURE;
+            break;
+        } else if (pos < 0) {
+            printf("The trace in %s is broken after step %llu\n", argv[2], machine.steps);
+            result = EXIT_FAILURE;
+            break;
+        }
+        if (machine.steps < step && step != ULLONG_MAX) {
+            printf("The trace ends at step %llu\n", machine.steps);
+        }
+        // The position shown is always the one just before the next step, like in the visual mode.
+        bfPrintState(codeFile.data, pos - 1, &machine, &view);
+    }
+
+    if (trace != NULL) {
+        bfCloseTraceReader(trace);
+        bfFreeMachine(&machine);
+    }
+    bfUnloadFile(&codeFile);
+    return result;
+}
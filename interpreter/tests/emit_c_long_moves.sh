@@ -0,0 +1,38 @@
+#!/bin/sh
+# Checks that the C --emit-c writes for code with moves longer than the
+# distance the generated code lets the tape head drift stays on its tape,
+# and prints the same results as the interpreter. Run from anywhere; it
+# needs gcc with AddressSanitizer.
+set -e
+cd "$(dirname "$0")/.."
+dir=$(mktemp -d)
+trap 'rm -rf "$dir"' EXIT
+
+gcc -O2 -pthread -o "$dir/interpreter" interpreter.c bf.c
+echo 7 > "$dir/input.txt"
+
+# Writes a run of count copies of a BF character.
+run() {
+    awk -v count="$2" -v char="$1" 'BEGIN { for (i = 0; i < count; ++i) printf "%s", char }'
+}
+
+# A single move of 300 cells with nothing else reaching far, and a trip
+# across 500 cells with a multiply loop 200 cells away at the far end.
+{ run '>' 300; echo '[->+<]>.'; } > "$dir/move.b"
+{ run '>' 300; printf '[->+<]>.,'; run '<' 500; printf '+.[->'; run '>' 200; printf '+';
+  run '<' 201; printf ']'; run '>' 201; echo '.'; } > "$dir/trip.b"
+
+for name in move trip; do
+    "$dir/interpreter" --emit-c="$dir/$name.c" "$dir/$name.b"
+    gcc -g -fsanitize=address -o "$dir/$name" "$dir/$name.c"
+    expected=$("$dir/interpreter" "$dir/$name.b" "$dir/input.txt")
+    actual=$("$dir/$name" "$dir/input.txt")
+    if [ "$actual" != "$expected" ]; then
+        echo "FAIL $name: the generated C printed"
+        echo "$actual"
+        echo "instead of"
+        echo "$expected"
+        exit 1
+    fi
+    echo "ok $name"
+done
@@ -0,0 +1,69 @@
+# Writes random BF programs made of the shapes the compiler looks for:
+# runs of adds and moves, clears, scans, multiply loops, counted loops and
+# nested loops, along with output and input. Each program goes on a line of
+# its own, and the same seed always gives the same programs.
+#     awk -v seed=1 -v count=20 -f fuzz_programs.awk
+BEGIN {
+    srand(seed == "" ? 1 : seed)
+    for (n = 0; n < (count == "" ? 20 : count); ++n) {
+        print block(0)
+    }
+}
+
+function pick(low, high) {
+    return low + int(rand() * (high - low + 1))
+}
+
+function repeat(text, times,    result) {
+    result = ""
+    while (times-- > 0) {
+        result = result text
+    }
+    return result
+}
+
+# A multiply loop, which moves the current cell into a few others with
+# factors and comes back to it (sometimes counting up instead of down).
+function multiply(    k, body, offset, d) {
+    body = rand() < 0.5 ? "+" : "-"
+    offset = 0
+    for (k = pick(1, 3); k > 0; --k) {
+        d = pick(-5, 5)
+        if (d == 0) {
+            d = 1
+        }
+        body = body repeat(d > 0 ? ">" : "<", d > 0 ? d : -d) repeat(rand() < 0.5 ? "+" : "-", pick(1, 3))
+        offset += d
+    }
+    return "[" body repeat(offset > 0 ? "<" : ">", offset > 0 ? offset : -offset) "]"
+}
+
+function block(depth,    code, parts, r, scans) {
+    code = ""
+    split("> < >> <<<< >>>>", scans, " ")
+    for (parts = pick(1, 8); parts > 0; --parts) {
+        r = rand()
+        if (r < 0.25) {
+            code = code repeat(rand() < 0.5 ? "+" : "-", pick(1, 12))
+        } else if (r < 0.45) {
+            code = code repeat(rand() < 0.5 ? ">" : "<", pick(1, 6))
+        } else if (r < 0.52) {
+            code = code "."
+        } else if (r < 0.55) {
+            code = code ","
+        } else if (r < 0.62) {
+            code = code "[-]"
+        } else if (r < 0.70) {
+            code = code multiply()
+        } else if (r < 0.75) {
+            code = code "[" scans[pick(1, 5)] "]"
+        } else if (r < 0.80) {
+            code = code "[+]"
+        } else if (r < 0.90 && depth < 3) {
+            code = code ">" repeat("+", pick(1, 9)) "[<" block(depth + 1) ">-]<"
+        } else if (depth < 3) {
+            code = code "[" block(depth + 1) "[-]]"
+        }
+    }
+    return code
+}
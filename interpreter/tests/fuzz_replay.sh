@@ -0,0 +1,33 @@
+#!/bin/sh
+# Checks random programs from fuzz_programs.awk with visual_replay.sh, so that
+# the screens of the visual mode and of replay are compared on every shape the
+# compiler looks for. Run from anywhere, optionally with a seed and how many
+# programs to try; it needs gcc.
+set -e
+cd "$(dirname "$0")/.."
+dir=$(mktemp -d)
+trap 'rm -rf "$dir"' EXIT
+
+gcc -O2 -pthread -o "$dir/interpreter" interpreter.c bf.c
+seed=${1:-1}
+count=${2:-40}
+awk -v seed="$seed" 'BEGIN { srand(seed); printf "["; for (i = 0; i < 50; ++i) printf "%s%d", i ? ", " : "", int(rand() * 301); print "]" }' \
+    > "$dir/input.txt"
+
+# Only the programs that finish in a reasonable number of steps without
+# running off the tape are checked.
+set --
+n=0
+awk -v seed="$seed" -v count="$count" -f tests/fuzz_programs.awk > "$dir/programs"
+while read -r program; do
+    n=$((n + 1))
+    printf '%s\n' "$program" > "$dir/$n.b"
+    if "$dir/interpreter" --max-steps=100000 "$dir/$n.b" "$dir/input.txt" > /dev/null 2>&1; then
+        set -- "$@" "$dir/$n.b" "$dir/input.txt"
+    fi
+done < "$dir/programs"
+if [ $# -eq 0 ]; then
+    echo "FAIL: none of the programs finished"
+    exit 1
+fi
+sh tests/visual_replay.sh "$@"
@@ -0,0 +1,52 @@
+#!/bin/sh
+# Checks that the screens the visual mode shows while going forward and back
+# with g and b are the same as the ones replay shows for the same steps of a
+# trace, in the same order. Run from anywhere, with pairs of code and input files to check, or
+# with none to check code.txt and the benchmark multiply program; it needs gcc.
+set -e
+cd "$(dirname "$0")/.."
+dir=$(mktemp -d)
+trap 'rm -rf "$dir"' EXIT
+
+gcc -O2 -pthread -o "$dir/interpreter" interpreter.c bf.c
+gcc -O2 -o "$dir/replay" replay.c bf.c
+
+# Prints every screen the visual mode or replay showed, in order.
+screens() {
+    awk '
+        { sub(/^CMD: /, "") }
+        /^Results:/ { block = $0; next }
+        { block = block "\n" $0 }
+        /^\.\.\. / { print block }'
+}
+
+if [ $# -eq 0 ]; then
+    set -- code.txt input.txt bench/mul.b bench/mul.txt
+fi
+checked=0
+while [ $# -ge 2 ]; do
+    code=$1 input=$2
+    shift 2
+    "$dir/interpreter" --trace="$dir/trace" "$code" "$input" > /dev/null
+    last=$("$dir/replay" "$code" "$dir/trace" | sed -n 's/^Step: //p')
+    if [ "$last" -lt 8 ]; then
+        continue
+    fi
+    # Forward, back, forward again, to the last step and back from it, with
+    # snapshots a seventh of the run apart so that going back restores them.
+    visual=$(printf 'g %s\nb %s\ng %s\ng %s\nb %s\n' $((last * 2 / 3)) $((last / 3)) \
+        $((last / 2)) $((last - 1)) $((last / 4)) |
+        "$dir/interpreter" --snapshot-interval=$((last / 7)) "$code" "$input" 0)
+    printf '%s\n' "$visual" | screens > "$dir/visual.txt"
+    # The part of the tape shown only moves once the head leaves it, so replay
+    # goes through the same steps in the same order to end up showing the same.
+    "$dir/replay" "$code" "$dir/trace" $(printf '%s\n' "$visual" | sed -n 's/^Step: //p') |
+        screens > "$dir/replay.txt"
+    if ! cmp -s "$dir/visual.txt" "$dir/replay.txt"; then
+        echo "FAIL $code: the visual mode and replay showed different screens"
+        diff "$dir/visual.txt" "$dir/replay.txt" | head -20
+        exit 1
+    fi
+    checked=$((checked + 1))
+done
+echo "ok replay ($checked programs)"
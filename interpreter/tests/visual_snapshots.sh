@@ -0,0 +1,71 @@
+#!/bin/sh
+# Checks that going back to an earlier step in the visual mode, by restoring
+# a snapshot and running forward from it, shows the same screen as going
+# straight to that step, and that it refuses to go back when the input comes
+# from a pipe. Run from anywhere; it needs gcc.
+set -e
+cd "$(dirname "$0")/.."
+dir=$(mktemp -d)
+trap 'rm -rf "$dir"' EXIT
+
+gcc -O2 -pthread -o "$dir/interpreter" interpreter.c bf.c
+
+# Prints the last screen the visual mode (or replay) showed for a step.
+screen() {
+    awk -v step="$1" '
+        { sub(/^CMD: /, "") }
+        /^Results:/ { block = $0; next }
+        { block = block "\n" $0 }
+        /^\.\.\. / && index(block "\n", "\nStep: " step "\n") { found = block }
+        END { print found }'
+}
+
+# Goes to a step, then further on, then back to it with b and with g, with
+# snapshots every so many steps (or only at the start) and with no memory
+# for them, so that they keep being dropped.
+check() {
+    code=$1 input=$2 target=$3 far=$4
+    shift 4
+    expected=$(printf 'g %s\n' "$target" | "$dir/interpreter" "$@" "$code" "$input" 0 | screen "$target")
+    if [ -z "$expected" ]; then
+        echo "FAIL: $code never showed step $target"
+        exit 1
+    fi
+    for commands in "g $far\nb $((far - target))" "g $far\ng $target"; do
+        actual=$(printf "$commands\n" | "$dir/interpreter" "$@" "$code" "$input" 0 | screen "$target")
+        if [ "$actual" != "$expected" ]; then
+            echo "FAIL $code $*: going back to step $target from step $far showed"
+            echo "$actual"
+            echo "instead of"
+            echo "$expected"
+            exit 1
+        fi
+    done
+}
+
+for options in "--snapshot-interval=0" "--snapshot-interval=1" "--snapshot-interval=3" \
+        "--snapshot-interval=3 --snapshot-memory=0"; do
+    check code.txt input.txt 35 40 $options
+    check code.txt input.txt 1 200 $options
+done
+for options in "--snapshot-interval=1000" "--snapshot-interval=1000 --snapshot-memory=0" \
+        "--snapshot-interval=0"; do
+    check bench/mul.b bench/mul.txt 70001 120000 $options
+done
+echo "ok round trip"
+
+# Input from a pipe can only be read once, so going back has to be refused
+# and the screen has to stay where it was.
+mkfifo "$dir/input.fifo"
+cat input.txt > "$dir/input.fifo" &
+output=$(printf 'g 40\nb 5\n' | "$dir/interpreter" code.txt "$dir/input.fifo" 0)
+wait
+if ! printf '%s\n' "$output" | grep -q "^CMD: Can't go back, since the input can't be read again$"; then
+    echo "FAIL: going back with the input in a pipe wasn't refused"
+    exit 1
+fi
+if [ -n "$(printf '%s\n' "$output" | screen 35)" ] || [ -z "$(printf '%s\n' "$output" | screen 40)" ]; then
+    echo "FAIL: going back with the input in a pipe moved away from step 40"
+    exit 1
+fi
+echo "ok pipe"